@@ -0,0 +1,138 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tracegen.hpp"
+
+using namespace std;
+
+// Runs L1simulate over a fixed matrix of synthetic traces and geometries and
+// prints one machine-readable row per run: references and cycles simulated
+// per second and the simulator's peak resident set size. Built and run by
+// `make bench`.
+
+struct Run {
+    double wall = 0;
+    long peak_rss_kb = 0;
+    bool ok = false;
+};
+
+// Runs `args` to completion and measures it.
+static Run run(const vector<string>& args) {
+    vector<char*> argv;
+    for (const string& a : args) argv.push_back(const_cast<char*>(a.c_str()));
+    argv.push_back(nullptr);
+    Run r;
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0) return r;
+    int status = 0;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) != pid) return r;
+    r.wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    r.peak_rss_kb = ru.ru_maxrss;
+    r.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return r;
+}
+
+// The value after the last ": " on the report line starting with `key`.
+static string report_value(const string& path, const string& key) {
+    ifstream f(path);
+    string line, value;
+    while (getline(f, line))
+        if (line.compare(0, key.size(), key) == 0) value = line.substr(line.rfind(' ') + 1);
+    return value;
+}
+
+int main(int argc, char* argv[]) {
+    string sim = "./L1simulate";
+    size_t refs = 50000;
+    bool json = false;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "--sim" && i + 1 < argc)
+            sim = argv[++i];
+        else if (a == "-n" && i + 1 < argc)
+            refs = stoul(argv[++i]);
+        else if (a == "--json")
+            json = true;
+        else if (a == "-h") {
+            cout << "--sim <path>: simulator to measure (default: ./L1simulate)\n";
+            cout << "-n <refs>: references per core (default: 50000)\n";
+            cout << "--json: print a JSON array instead of CSV\n";
+            cout << "-h: prints this help\n";
+            return 0;
+        }
+    }
+
+    char tmpl[] = "/tmp/l1benchXXXXXX";
+    if (!mkdtemp(tmpl)) {
+        cerr << "Cannot create a temporary directory\n";
+        return 1;
+    }
+    string dir = tmpl;
+
+    static const char* patterns[] = {"private", "true", "false", "prodcons", "random"};
+    static const int core_counts[] = {4, 16};
+    static const char* geometries[][3] = {{"5", "2", "5"}, {"7", "8", "6"}};
+
+    if (json)
+        cout << "[\n";
+    else
+        cout << "pattern,cores,s,E,b,refs,cycles,sim_seconds,wall_seconds,refs_per_sec,"
+                "cycles_per_sec,peak_rss_kb\n";
+    bool first = true, failed = false;
+    for (const char* name : patterns) {
+        Pattern pat;
+        parse_pattern(name, pat);
+        for (int cores : core_counts) {
+            string pref = dir + "/" + name + to_string(cores);
+            vector<vector<Ref>> traces = generate_traces(pat, cores, refs, 1);
+            for (int c = 0; c < cores; c++)
+                write_binary_trace(pref + "_proc" + to_string(c) + ".trace", traces[c], cores, c);
+            for (auto& g : geometries) {
+                string out = dir + "/report.txt";
+                Run r = run({sim, "-t", pref, "-s", g[0], "-E", g[1], "-b", g[2], "-o", out});
+                if (!r.ok) {
+                    cerr << "Run failed: " << name << " " << cores << " cores\n";
+                    failed = true;
+                    continue;
+                }
+                double secs = atof(report_value(out, "Simulation Run Time").c_str());
+                unsigned long long cycles = stoull(report_value(out, "Total Cycles"));
+                unsigned long long total = refs * cores;
+                char row[512];
+                if (json)
+                    snprintf(row, sizeof(row),
+                             "%s  {\"pattern\": \"%s\", \"cores\": %d, \"s\": %s, \"E\": %s, "
+                             "\"b\": %s, \"refs\": %llu, \"cycles\": %llu, \"sim_seconds\": %.6f, "
+                             "\"wall_seconds\": %.6f, \"refs_per_sec\": %.0f, "
+                             "\"cycles_per_sec\": %.0f, \"peak_rss_kb\": %ld}",
+                             first ? "" : ",\n", name, cores, g[0], g[1], g[2], total, cycles,
+                             secs, r.wall, secs > 0 ? total / secs : 0.0,
+                             secs > 0 ? cycles / secs : 0.0, r.peak_rss_kb);
+                else
+                    snprintf(row, sizeof(row), "%s,%d,%s,%s,%s,%llu,%llu,%.6f,%.6f,%.0f,%.0f,%ld\n",
+                             name, cores, g[0], g[1], g[2], total, cycles, secs, r.wall,
+                             secs > 0 ? total / secs : 0.0, secs > 0 ? cycles / secs : 0.0,
+                             r.peak_rss_kb);
+                cout << row << flush;
+                first = false;
+            }
+            for (int c = 0; c < cores; c++) unlink((pref + "_proc" + to_string(c) + ".trace").c_str());
+        }
+    }
+    if (json) cout << "\n]\n";
+    unlink((dir + "/report.txt").c_str());
+    rmdir(dir.c_str());
+    return failed ? 1 : 0;
+}
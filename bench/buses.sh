@@ -0,0 +1,43 @@
+#!/bin/sh
+# Measures what banking the bus buys.
+#
+# usage: bench/buses.sh [refs-per-core] [cores] [bus counts...]
+#
+# Runs a tracegen workload of each pattern with every bus count (1, 2, 4
+# and 8 by default) and arbitration, and prints the total cycles, the
+# average bus utilisation, the busiest bus's share of the transactions and
+# the spread of idle cycles between the cores.
+
+set -e
+cd "$(dirname "$0")/.."
+REFS=${1:-100000}
+CORES=${2:-8}
+shift 2 2>/dev/null || shift $#
+BUSES=${*:-1 2 4 8}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s compile tracegen
+
+printf "%-9s %5s %-13s %12s %7s %8s %12s %12s\n" \
+    pattern buses arbitration cycles util busiest idle-min idle-max
+for k in private true false prodcons random; do
+    ./tracegen -o "$DIR/$k" -k "$k" -p "$CORES" -n "$REFS" > /dev/null
+    for n in $BUSES; do
+        for arb in fixed round-robin oldest-first; do
+            ./L1simulate -t "$DIR/$k" -s 6 -E 4 -b 5 --buses "$n" --arbitration "$arb" \
+                --interval 10000 -o "$DIR/out.txt"
+            awk -v k="$k" -v n="$n" -v arb="$arb" '
+                /^Idle Cycles/ { if (lo == "" || $NF < lo) lo = $NF; if ($NF > hi) hi = $NF }
+                /^Total Bus Transactions/ { tx = $NF }
+                /^Bus [0-9]+: / { if ($3 > top) top = $3 }
+                /^Bus Utilization \(average\)/ { util = $NF }
+                /^Total Cycles/ { cycles = $NF }
+                END {
+                    if (n == 1) top = tx
+                    printf "%-9s %5d %-13s %12d %7s %7.1f%% %12d %12d\n", k, n, arb, cycles,
+                           util, tx ? top * 100 / tx : 0, lo, hi
+                }' "$DIR/out.txt"
+        done
+    done
+done
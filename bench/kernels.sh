@@ -0,0 +1,53 @@
+#!/bin/sh
+# Compares the geometry-specialised kernels with the generic one.
+#
+# usage: bench/kernels.sh [refs-per-core] [runs]
+#
+# Runs a synthetic 4-core workload on several geometries, each specialised
+# and with --generic, keeps the best of [runs] timings and prints simulated
+# references per second for both.
+
+set -e
+cd "$(dirname "$0")/.."
+REFS=${1:-500000}
+RUNS=${2:-3}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s compile
+
+awk -v refs="$REFS" -v dir="$DIR" 'BEGIN {
+    srand(4);
+    for (c = 0; c < 4; c++) {
+        f = dir "/kern_proc" c ".trace";
+        for (i = 0; i < refs; i++) {
+            if (rand() < 0.05)
+                a = int(rand() * 4096) * 4;
+            else
+                a = (c + 1) * 1048576 + int(rand() * rand() * 65536) * 4;
+            printf "%s 0x%08x\n", (rand() < 0.3 ? "W" : "R"), a > f;
+        }
+        close(f);
+    }
+}'
+
+best() {
+    # best <args...>: lowest run time of RUNS runs
+    t=
+    for i in $(seq "$RUNS"); do
+        ./L1simulate -t "$DIR/kern" "$@" -o "$DIR/out.txt"
+        r=$(awk '/Simulation Run Time/ { print $NF }' "$DIR/out.txt")
+        t=$(awk -v a="$t" -v b="$r" 'BEGIN { print (a == "" || b < a) ? b : a }')
+    done
+    echo "$t"
+}
+
+printf "%-10s %14s %14s %8s\n" geometry generic-ref/s special-ref/s gain
+for g in "5 2 5" "4 1 4" "6 4 5" "7 8 6" "8 16 4"; do
+    set -- $g
+    gen=$(best -s "$1" -E "$2" -b "$3" --generic)
+    spec=$(best -s "$1" -E "$2" -b "$3")
+    awk -v g="$1/$2/$3" -v n="$((REFS * 4))" -v a="$gen" -v b="$spec" 'BEGIN {
+        printf "%-10s %14.0f %14.0f %7.2fx\n", g, n / a, n / b, a / b
+    }'
+done
@@ -0,0 +1,66 @@
+#!/bin/sh
+# Compares the cycle-by-cycle engine (--no-batch) with the batched one and
+# with --parallel on the bundled app traces and on a synthetic hit-heavy
+# workload, checking all three give the same report.
+#
+# usage: bench/parallel.sh [threads] [refs-per-core] [core counts...]
+#
+# Prints one line per workload with the three run times and the speedups
+# over --no-batch.
+
+set -e
+cd "$(dirname "$0")/.."
+THREADS=${1:-$(nproc)}
+[ $# -gt 0 ] && shift
+REFS=${1:-200000}
+[ $# -gt 0 ] && shift
+COUNTS=${*:-"4 8 16"}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s compile
+
+run() {
+    # run <name> <prefix> <args...>
+    name=$1 pref=$2
+    shift 2
+    ./L1simulate -t "$pref" "$@" --no-batch -o "$DIR/cyc.txt"
+    ./L1simulate -t "$pref" "$@" -o "$DIR/seq.txt"
+    ./L1simulate -t "$pref" "$@" --parallel --threads "$THREADS" -o "$DIR/par.txt"
+    same=yes
+    grep -v "Run Time" "$DIR/cyc.txt" > "$DIR/cyc.cmp"
+    grep -v "Run Time" "$DIR/seq.txt" | cmp -s - "$DIR/cyc.cmp" || same=NO
+    grep -v "Run Time" "$DIR/par.txt" | cmp -s - "$DIR/cyc.cmp" || same=NO
+    awk -v name="$name" -v same="$same" '
+        /Simulation Run Time/ { t[FILENAME] = $NF }
+        END {
+            c = t[ARGV[1]]; s = t[ARGV[2]]; p = t[ARGV[3]];
+            printf "%-16s %10.4f %10.4f %10.4f %8.2fx %8.2fx %10s\n", name, c, s, p,
+                   (s > 0 ? c / s : 0), (p > 0 ? c / p : 0), same
+        }
+    ' "$DIR/cyc.txt" "$DIR/seq.txt" "$DIR/par.txt"
+}
+
+printf "%-16s %10s %10s %10s %9s %9s %10s\n" workload cycle-sec batch-sec par-sec batch-x par-x identical
+for t in inputs/*_proc0.trace; do
+    pref=${t%_proc0.trace}
+    run "$(basename "$pref")" "$pref" -s 5 -E 2 -b 5
+done
+for p in $COUNTS; do
+    # Mostly private, cache-resident streams with an occasional shared write.
+    awk -v cores="$p" -v refs="$REFS" -v dir="$DIR" 'BEGIN {
+        srand(2);
+        for (c = 0; c < cores; c++) {
+            f = dir "/hits_proc" c ".trace";
+            for (i = 0; i < refs; i++) {
+                if (rand() < 0.001)
+                    printf "W 0x%08x\n", int(rand() * 64) * 4 > f;
+                else
+                    printf "%s 0x%08x\n", (rand() < 0.3 ? "W" : "R"),
+                           (c + 1) * 1048576 + int(rand() * 2048) * 4 > f;
+            }
+            close(f);
+        }
+    }'
+    run "hits-$p" "$DIR/hits" -p "$p" -s 6 -E 8 -b 5
+done
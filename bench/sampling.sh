@@ -0,0 +1,70 @@
+#!/bin/sh
+# Measures the error of --sample against full simulation.
+#
+# usage: bench/sampling.sh [period] [refs-per-core] [sample-size] [warm-up]
+# (period, sample size and warm-up in cycles)
+#
+# Runs every trace set in inputs/ and a tracegen workload of each pattern
+# (4 cores) with and without sampling and prints, per core, the sampled
+# estimate's relative error in cycles, misses and traffic, whether the
+# full-simulation cycle count lies within the reported 95% interval, and the
+# speedup of the whole run. Fails if a sampled core reports more misses
+# than references.
+
+set -e
+cd "$(dirname "$0")/.."
+PERIOD=${1:-200000}
+REFS=${2:-400000}
+SIZE=${3:-10000}
+WARM=${4:-2000}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s compile tracegen
+
+sets=
+for f in inputs/*_proc0.trace; do sets="$sets ${f%_proc0.trace}"; done
+for k in private true false prodcons random; do
+    ./tracegen -o "$DIR/$k" -k "$k" -p 4 -n "$REFS" > /dev/null
+    sets="$sets $DIR/$k"
+done
+
+printf "%-10s %4s %12s %12s %8s %8s %8s %8s %6s %8s\n" \
+    trace core full-cycles est-cycles cyc-err ci miss-err trf-err in-ci speedup
+for t in $sets; do
+    ./L1simulate -t "$t" -s 6 -E 4 -b 5 -o "$DIR/full.txt"
+    ./L1simulate -t "$t" -s 6 -E 4 -b 5 --sample "$PERIOD" --sample-size "$SIZE" \
+        --sample-warmup "$WARM" -o "$DIR/sampled.txt"
+    awk -v name="$(basename "$t")" '
+        function err(est, ref) { return ref ? (est - ref) / ref * 100 : 0 }
+        FNR == 1 { file++ }
+        /^Core [0-9]+ Statistics/ { core = $2 }
+        /^Total Execution Cycles/ { exec[file, core] = $NF }
+        /^Idle Cycles/ { cyc[file, core] = exec[file, core] + $NF }
+        /^Cache Misses/ { miss[file, core] = $NF }
+        /^Data Traffic/ { trf[file, core] = $NF }
+        /^Simulation Run Time/ { secs[file] = $NF }
+        /^Core [0-9]+: / { sub(":", "", $2); core = $2 }
+        /^  Cycles:/ { ci[core] = $NF }
+        END {
+            speed = secs[2] > 0 ? secs[1] / secs[2] : 0
+            for (c = 0; (1, c) in cyc; c++) {
+                half = ci[c] + 0
+                inside = (ci[c] ~ /%$/ && cyc[2, c] * (1 - half / 100) <= cyc[1, c] &&
+                          cyc[1, c] <= cyc[2, c] * (1 + half / 100)) ? "yes" : "no"
+                printf "%-10s %4d %12d %12d %7.2f%% %8s %7.2f%% %7.2f%% %6s %7.1fx\n", name, c,
+                       cyc[1, c], cyc[2, c], err(cyc[2, c], cyc[1, c]), ci[c],
+                       err(miss[2, c], miss[1, c]), err(trf[2, c], trf[1, c]), inside, speed
+            }
+        }' "$DIR/full.txt" "$DIR/sampled.txt"
+    # An estimate can never have more misses than references.
+    awk -v name="$(basename "$t")" '
+        /^Core [0-9]+ Statistics/ { core = $2 }
+        /^Total Instructions/ { refs = $NF }
+        /^Cache Misses/ && $NF > refs {
+            printf "%s core %d: %d misses for %d references\n", name, core, $NF, refs
+            bad = 1
+        }
+        END { exit bad }' "$DIR/sampled.txt" || fail=1
+done
+exit ${fail:-0}
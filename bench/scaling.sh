@@ -0,0 +1,46 @@
+#!/bin/sh
+# Times L1simulate on the same synthetic workload at growing core counts.
+#
+# usage: bench/scaling.sh [refs-per-core] [core counts...]
+#
+# Each core reads and writes a private region plus a small region shared by
+# all cores, so both the snoop paths and the per-core loops are exercised.
+# Prints one line per core count and simulator mode.
+
+set -e
+cd "$(dirname "$0")/.."
+REFS=${1:-20000}
+[ $# -gt 0 ] && shift
+COUNTS=${*:-"4 8 16 32 64"}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s compile
+
+printf "%-6s %-14s %10s %12s %10s %12s\n" cores mode refs cycles seconds refs/sec
+for p in $COUNTS; do
+    awk -v cores="$p" -v refs="$REFS" -v dir="$DIR" 'BEGIN {
+        srand(1);
+        for (c = 0; c < cores; c++) {
+            f = dir "/scale_proc" c ".trace";
+            for (i = 0; i < refs; i++) {
+                if (rand() < 0.2)
+                    a = int(rand() * 1024) * 4;
+                else
+                    a = (c + 1) * 1048576 + int(rand() * 16384) * 4;
+                printf "%s 0x%08x\n", (rand() < 0.3 ? "W" : "R"), a > f;
+            }
+            close(f);
+        }
+    }'
+    for mode in probe snoop-filter; do
+        extra=
+        [ "$mode" = snoop-filter ] && extra=--snoop-filter
+        ./L1simulate -t "$DIR/scale" -p "$p" -s 6 -E 4 -b 5 $extra -o "$DIR/out.txt"
+        awk -v p="$p" -v mode="$mode" -v refs="$((REFS * p))" '
+            /Simulation Run Time/ { t = $NF }
+            /Total Cycles/ { cyc = $NF }
+            END { printf "%-6s %-14s %10d %12d %10.4f %12.0f\n", p, mode, refs, cyc, t, (t > 0 ? refs / t : 0) }
+        ' "$DIR/out.txt"
+    done
+done
@@ -0,0 +1,60 @@
+#!/bin/sh
+# Compares running many small jobs as separate L1simulate processes with
+# sending them to one L1simulate --serve, and checks both give the same
+# reports.
+#
+# usage: bench/serve.sh [jobs] [refs-per-core] [threads]
+#
+# Each job simulates one of a few geometries on the same 4-core text trace
+# set, as a CI script sweeping a parameter would. Prints the jobs per second
+# of both ways and the speedup.
+
+set -e
+cd "$(dirname "$0")/.."
+JOBS=${1:-200}
+REFS=${2:-5000}
+THREADS=${3:-$(nproc)}
+DIR=$(mktemp -d)
+SOCK="$DIR/l1sim.sock"
+trap 'kill $SERVER 2>/dev/null; rm -rf "$DIR"' EXIT
+
+make -s compile tracegen
+./tracegen -o "$DIR/t" -k true -p 4 -n "$REFS" > /dev/null
+
+i=0
+while [ $i -lt "$JOBS" ]; do
+    echo "-t $DIR/t -s $((4 + i % 4)) -E $((1 << (i % 3))) -b 5 --id $i"
+    i=$((i + 1))
+done > "$DIR/jobs"
+
+now() { date +%s.%N; }
+since() { awk -v a="$(now)" -v b="$1" 'BEGIN { print a - b }'; }
+
+start=$(now)
+while read -r line; do
+    id=${line##* }
+    ./L1simulate ${line% --id *} -o "$DIR/cli.$id"
+done < "$DIR/jobs"
+cli=$(since "$start")
+
+./L1simulate --serve "$SOCK" --threads "$THREADS" &
+SERVER=$!
+while [ ! -S "$SOCK" ]; do sleep 0.05; done
+start=$(now)
+./l1client.py -S "$SOCK" --batch "$DIR/jobs" > "$DIR/served"
+served=$(since "$start")
+
+# Split the served reports by id and compare them with the CLI ones.
+awk -v dir="$DIR" '/^### / { f = dir "/srv." $2; next } { print > f }' "$DIR/served"
+same=yes
+i=0
+while [ $i -lt "$JOBS" ]; do
+    grep -v "Run Time" "$DIR/cli.$i" > "$DIR/a"
+    grep -v "Run Time" "$DIR/srv.$i" > "$DIR/b"
+    cmp -s "$DIR/a" "$DIR/b" || same=NO
+    i=$((i + 1))
+done
+
+printf "%-8s %12s %12s %9s %10s\n" jobs cli-jobs/s serve-jobs/s speedup identical
+echo "$JOBS $cli $served $same" | awk '{
+    printf "%-8d %12.1f %12.1f %8.1fx %10s\n", $1, $1 / $2, $1 / $3, $2 / $3, $4 }'
@@ -2,16 +2,117 @@
 #define BUS_HPP
 #include <algorithm>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 using namespace std;
 
 struct Bus {
     unsigned long long busy_until;
+    unsigned long long transactions = 0, busy = 0;  // over the whole run
+    int next = 0;  // round-robin: the core first in line for this bus
     Bus() : busy_until(0) {}
     bool free_at(unsigned long long cycle) { return cycle >= busy_until; }
     void occupy(unsigned long long cycle, unsigned long long duration) {
         busy_until = max(busy_until, cycle) + duration;
+        transactions++;
+        busy += duration;
     }
 };
 
-#endif
\ No newline at end of file
+// Which core gets a free bus when several want it in the same cycle. FIXED
+// is the order of the issue loop, lowest core first.
+enum Arbitration { ARB_FIXED, ARB_ROUND_ROBIN, ARB_OLDEST };
+
+inline const char* arbitration_name(Arbitration a) {
+    switch (a) {
+    case ARB_ROUND_ROBIN:
+        return "round-robin";
+    case ARB_OLDEST:
+        return "oldest-first";
+    default:
+        return "fixed";
+    }
+}
+
+// Reads an arbitration_name(); false if `name` is none of them.
+inline bool parse_arbitration(const string& name, Arbitration& a) {
+    for (Arbitration x : {ARB_FIXED, ARB_ROUND_ROBIN, ARB_OLDEST})
+        if (name == arbitration_name(x)) {
+            a = x;
+            return true;
+        }
+    return false;
+}
+
+// --buses: N snooping buses, bus k serving the blocks whose number is k
+// modulo N. A transaction only ever concerns one block, so the buses are
+// independent and each has its own occupancy and arbitration.
+//
+// Arbitration works by ordering the issue loop: cores wanting the same bus
+// come in its priority order, so the first to ask gets it and the rest see
+// it busy, as with FIXED. Round-robin ranks cores from the bus's `next`,
+// which moves past each core it grants. Oldest-first ranks them by the
+// cycle they were first refused the bus for their current reference (a
+// core asking for the first time counts as asking now), ties round-robin.
+struct Interconnect {
+    static const unsigned long long NOT_WAITING = UINT64_MAX;
+
+    vector<Bus> buses;
+    Arbitration arbitration;
+    vector<unsigned long long> waiting_since;  // per core, for ARB_OLDEST
+
+    Interconnect(int n, Arbitration arbitration, int cores)
+        : buses(max(n, 1)), arbitration(arbitration), waiting_since(cores, NOT_WAITING) {}
+
+    Bus& bus(unsigned int block) { return buses.size() == 1 ? buses[0] : buses[block % buses.size()]; }
+
+    // The last cycle any bus is busy.
+    unsigned long long busy_until() const {
+        unsigned long long t = 0;
+        for (const Bus& b : buses) t = max(t, b.busy_until);
+        return t;
+    }
+
+    void refused(int core, unsigned long long cycle) {
+        if (waiting_since[core] == NOT_WAITING) waiting_since[core] = cycle;
+    }
+    void granted(Bus& bus, int core) {
+        waiting_since[core] = NOT_WAITING;
+        bus.next = core + 1 == int(waiting_since.size()) ? 0 : core + 1;
+    }
+
+    // Fills `order` with the cores in the order the issue loop should take
+    // them in `cycle`; block_of(c) is the block core c's next reference is
+    // for. Cores for different buses may come in any order between them.
+    template <class BlockOf>
+    void issue_order(unsigned long long cycle, vector<int>& order, BlockOf block_of) {
+        int cores = int(waiting_since.size());
+        keys.resize(cores);
+        order.resize(cores);
+        for (int c = 0; c < cores; c++) {
+            int rank = c - bus(block_of(c)).next;
+            if (rank < 0) rank += cores;
+            unsigned long long since = arbitration == ARB_OLDEST ? min(waiting_since[c], cycle) : 0;
+            keys[c] = {since, rank};
+            order[c] = c;
+        }
+        sort(order.begin(), order.end(), [&](int x, int y) { return keys[x] < keys[y]; });
+    }
+
+    template <class IO>
+    void serialize(IO& io) {
+        for (Bus& b : buses) {
+            io(b.busy_until);
+            io(b.transactions);
+            io(b.busy);
+            io(b.next);
+        }
+        io.vec(waiting_since);
+    }
+
+private:
+    vector<pair<unsigned long long, int>> keys;
+};
+
+#endif
@@ -1,41 +1,176 @@
 #ifndef CACHE_HPP
 #define CACHE_HPP
 
+#include <cstdint>
+#include <vector>
+#include "policy.hpp"
 #include "types.hpp"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CACHE_X86_SIMD 1
+#endif
+
+using namespace std;
+
+// How find_line compares tags: one way at a time, or all the ways of a set
+// four (SSE2) or eight (AVX2) at a time.
+enum TagMatch { MATCH_SCALAR, MATCH_SSE2, MATCH_AVX2 };
+
+inline TagMatch best_tag_match() {
+#ifdef CACHE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return MATCH_AVX2;
+    if (__builtin_cpu_supports("sse2")) return MATCH_SSE2;
+#endif
+    return MATCH_SCALAR;
+}
+
+inline const char* tag_match_name(TagMatch m) {
+    return m == MATCH_AVX2 ? "AVX2" : m == MATCH_SSE2 ? "SSE2" : "scalar";
+}
+
+// Lines are stored as a structure of arrays in one contiguous block: per set,
+// the tags (padded to a multiple of eight ways so whole sets can be loaded as
+// vectors) and one metadata byte per way holding the valid bit and the MESI
+// state. The replacement policy keeps its own per-line state. A non-zero
+// Ways fixes the associativity at compile time so the way loops unroll.
+template <class Policy = LRUPolicy, int Ways = 0>
 struct Cache {
     int S, A, B;
-    vector<vector<Line>> sets;
     unsigned long long use_counter;
 
-    Cache(int s, int E, int b) : S(1 << s), A(E), B(1 << b), use_counter(0) {
-        sets.resize(S, vector<Line>(A));
+    Cache(int s, int E, int b, TagMatch want = best_tag_match())
+        : S(1 << s), A(E), B(1 << b), use_counter(0),
+          match(E < 4 ? MATCH_SCALAR : want), policy(1 << s, E) {
+        stride = match == MATCH_SCALAR ? A : (A + 7) & ~7;
+        meta_off = size_t(S) * stride * sizeof(uint32_t);
+        storage.assign(meta_off + size_t(S) * A, 0);
     }
 
-    int find_line(unsigned long long tag, int set) {
-        for (int i = 0; i < A; i++) {
-            if (sets[set][i].valid && sets[set][i].tag == tag &&
-                sets[set][i].state != I) {
-                return i;
-            }
+    bool valid(int set, int idx) const { return meta(set)[idx] & VALID; }
+    State state(int set, int idx) const { return State(meta(set)[idx] & STATE_MASK); }
+    unsigned int tag(int set, int idx) const { return tags(set)[idx]; }
+    unsigned long long last_used(int set, int idx) const { return policy.stamp(set, idx); }
+    Line line(int set, int idx) const {
+        Line L;
+        L.valid = valid(set, idx);
+        L.state = state(set, idx);
+        L.tag = tag(set, idx);
+        L.last_used = last_used(set, idx);
+        return L;
+    }
+
+    void set_line(int set, int idx, bool v, State st, unsigned int t,
+                  unsigned long long used) {
+        meta(set)[idx] = (v ? VALID : 0) | st;
+        tags(set)[idx] = t;
+        policy.restamp(set, idx, used);
+    }
+    void set_state(int set, int idx, State st) {
+        meta(set)[idx] = (meta(set)[idx] & VALID) | st;
+    }
+    // Installs a fetched block and marks it most recently used.
+    void fill(int set, int idx, unsigned int t, State st) {
+        meta(set)[idx] = VALID | st;
+        tags(set)[idx] = t;
+        policy.fill(set, idx, use_counter);
+    }
+    // Recency stamp for a hit, to be applied later with set_line.
+    unsigned long long access_stamp() { return policy.access(use_counter); }
+
+    int find_line(unsigned int tag, int set) const {
+#ifdef CACHE_X86_SIMD
+        if (match == MATCH_AVX2) return find_avx2(tags(set), meta(set), ways(), tag);
+        if (match == MATCH_SSE2) return find_sse2(tags(set), meta(set), ways(), tag);
+#endif
+        const uint32_t* t = tags(set);
+        const uint8_t* m = meta(set);
+        for (int i = 0; i < ways(); i++) {
+            if (live(m[i]) && t[i] == tag) return i;
         }
         return -1;
     }
 
+    // An invalid way if there is one, otherwise the policy's choice.
     int choose_victim(int set) {
-        int victim = 0;
-        unsigned long long min_used = UINT64_MAX;
-        for (int i = 0; i < A; i++) {
-            if (!sets[set][i].valid) return i;
-            if (sets[set][i].last_used < min_used) {
-                min_used = sets[set][i].last_used;
-                victim = i;
+        const uint8_t* m = meta(set);
+        for (int i = 0; i < ways(); i++)
+            if (!(m[i] & VALID)) return i;
+        return policy.victim(set, ways());
+    }
+
+    // Passes the lines, way by way, and the replacement state to a
+    // checkpoint (checkpoint.hpp). The tag layout depends on the tag match,
+    // so it is not written as it sits in memory.
+    template <class IO>
+    void serialize(IO& io) {
+        io(use_counter);
+        for (int set = 0; set < S; set++)
+            for (int i = 0; i < A; i++) {
+                io(tags(set)[i]);
+                io(meta(set)[i]);
+            }
+        policy.serialize(io);
+    }
+
+    // Bytes of line storage held by this cache.
+    size_t memory_bytes() const { return sizeof(Cache) + storage.size() + policy.bytes(); }
+    TagMatch tag_match() const { return match; }
+
+private:
+    static const uint8_t VALID = 4, STATE_MASK = 3;
+
+    TagMatch match;
+    int stride;
+    size_t meta_off;
+    vector<unsigned char> storage;
+    Policy policy;
+
+    int ways() const { return Ways ? Ways : A; }
+    static bool live(uint8_t m) { return (m & VALID) && (m & STATE_MASK) != I; }
+
+    uint32_t* tags(int set) {
+        return reinterpret_cast<uint32_t*>(storage.data()) + size_t(set) * stride;
+    }
+    const uint32_t* tags(int set) const {
+        return reinterpret_cast<const uint32_t*>(storage.data()) + size_t(set) * stride;
+    }
+    uint8_t* meta(int set) { return storage.data() + meta_off + size_t(set) * A; }
+    const uint8_t* meta(int set) const { return storage.data() + meta_off + size_t(set) * A; }
+
+#ifdef CACHE_X86_SIMD
+    // Both scan the set in vector-sized chunks and return the first way whose
+    // tag matches and whose line is valid and not I, like the scalar loop.
+    static int find_sse2(const uint32_t* t, const uint8_t* m, int ways, unsigned int tag) {
+        __m128i key = _mm_set1_epi32(int(tag));
+        for (int base = 0; base < ways; base += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + base));
+            unsigned hits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+            for (; hits; hits &= hits - 1) {
+                int i = base + __builtin_ctz(hits);
+                if (i >= ways) break;
+                if (live(m[i])) return i;
             }
         }
-        return victim;
+        return -1;
     }
 
-    void touch(int set, int idx) { sets[set][idx].last_used = use_counter++; }
+    __attribute__((target("avx2")))
+    static int find_avx2(const uint32_t* t, const uint8_t* m, int ways, unsigned int tag) {
+        __m256i key = _mm256_set1_epi32(int(tag));
+        for (int base = 0; base < ways; base += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(t + base));
+            unsigned hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key)));
+            for (; hits; hits &= hits - 1) {
+                int i = base + __builtin_ctz(hits);
+                if (i >= ways) break;
+                if (live(m[i])) return i;
+            }
+        }
+        return -1;
+    }
+#endif
 };
 
-#endif
\ No newline at end of file
+#endif
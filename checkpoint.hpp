@@ -0,0 +1,129 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checkpoints (--checkpoint-at, --restore) are a CheckpointHeader followed by
+// the simulation state. The state is written and read by the same code:
+// each part has a serialize(io, ...) that passes its fields, in order, to a
+// CheckpointWriter or a CheckpointReader. Values are stored in host byte
+// order, so a checkpoint is only read back on the kind of machine that
+// wrote it.
+const char CKPT_MAGIC[8] = {'L', '1', 'C', 'K', 'P', 'T', '\0', '\0'};
+const uint32_t CKPT_VERSION = 2;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cores;
+    int32_t s, E, b;
+    uint32_t replacement;
+    uint32_t buses, arbitration;
+    uint64_t cycle;  // the cycle the state was taken at, before it ran
+    uint64_t refs;   // references completed by then, over all cores
+};
+static_assert(sizeof(CheckpointHeader) == 56, "checkpoint header is 56 bytes");
+
+class CheckpointWriter {
+public:
+    static const bool loading = false;
+
+    bool open(const string& path, CheckpointHeader h, string& err) {
+        f.open(path, ios::binary | ios::trunc);
+        if (!f) {
+            err = "Cannot open checkpoint file: " + path;
+            return false;
+        }
+        memcpy(h.magic, CKPT_MAGIC, sizeof(h.magic));
+        h.version = CKPT_VERSION;
+        (*this)(h);
+        name = path;
+        return true;
+    }
+    template <class T>
+    void operator()(T& v) {
+        f.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    template <class T>
+    void vec(vector<T>& v) {
+        uint64_t n = v.size();
+        (*this)(n);
+        f.write(reinterpret_cast<const char*>(v.data()), n * sizeof(T));
+    }
+    bool good() const { return bool(f); }
+    bool finish(string& err) {
+        f.close();
+        if (!f) err = "Cannot write checkpoint file: " + name;
+        return bool(f);
+    }
+
+private:
+    ofstream f;
+    string name;
+};
+
+// Reads what a CheckpointWriter wrote. The containers it fills are already
+// sized for the configuration, so a vector of another length means the
+// checkpoint does not belong to it.
+class CheckpointReader {
+public:
+    static const bool loading = true;
+
+    bool open(const string& path, CheckpointHeader& h, string& err) {
+        f.open(path, ios::binary);
+        name = path;
+        if (!f) {
+            err = "Cannot open checkpoint file: " + path;
+            return false;
+        }
+        (*this)(h);
+        if (!ok || memcmp(h.magic, CKPT_MAGIC, sizeof(h.magic)) != 0) {
+            err = path + " is not a checkpoint";
+            return false;
+        }
+        if (h.version != CKPT_VERSION) {
+            err = "Unsupported checkpoint version in " + path;
+            return false;
+        }
+        return true;
+    }
+    template <class T>
+    void operator()(T& v) {
+        if (!f.read(reinterpret_cast<char*>(&v), sizeof(v))) ok = false;
+    }
+    template <class T>
+    void vec(vector<T>& v) {
+        uint64_t n = 0;
+        (*this)(n);
+        if (n != v.size()) {
+            ok = false;
+            return;
+        }
+        if (!f.read(reinterpret_cast<char*>(v.data()), n * sizeof(T))) ok = false;
+    }
+    // Whether everything read was there and nothing follows it.
+    bool finish(string& err) {
+        if (ok && f.peek() != EOF) ok = false;
+        if (!ok) err = "Truncated or mismatched checkpoint " + name;
+        return ok;
+    }
+    bool good() const { return ok; }
+
+private:
+    ifstream f;
+    string name;
+    bool ok = true;
+};
+
+inline bool read_checkpoint_header(const string& path, CheckpointHeader& h, string& err) {
+    CheckpointReader r;
+    return r.open(path, h, err);
+}
+
+#endif
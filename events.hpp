@@ -0,0 +1,190 @@
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "types.hpp"
+
+using namespace std;
+
+// Planned line updates waiting for their apply cycle. Changes sit on a timing
+// wheel bucketed by apply_cycle, and every outstanding change is also linked
+// into a list for its (core, set) so snoops can ask "is anything pending for
+// this block" without scanning the whole queue. Nodes come from a pool that
+// is recycled, so once warmed up pushing and applying never allocate.
+struct PlannedChangeQueue {
+    struct Node {
+        PlannedChange pc;
+        unsigned long long seq;
+        int prev, next;
+    };
+
+    PlannedChangeQueue(int cores, int sets, int horizon = 4)
+        : sets(sets), free_head(-1), count(0), next_seq(0) {
+        int slots = 1;
+        while (slots < horizon) slots <<= 1;
+        wheel.resize(slots);
+        mask = slots - 1;
+        heads.assign(size_t(cores) * sets, -1);
+    }
+
+    bool empty() const { return count == 0; }
+
+    // `now` is the current cycle; the change must land within the horizon.
+    void push(const PlannedChange& pc, unsigned long long now) {
+        assert(pc.apply_cycle > now && pc.apply_cycle - now <= mask);
+        (void)now;
+        int h = alloc();
+        pool[h].pc = pc;
+        pool[h].seq = next_seq++;
+        int& head = heads[slot(pc.core, pc.set)];
+        pool[h].prev = -1;
+        pool[h].next = head;
+        if (head >= 0) pool[head].prev = h;
+        head = h;
+        wheel[pc.apply_cycle & mask].push_back(h);
+        count++;
+    }
+
+    // Applies every change due at `cycle`, state transitions first and then
+    // invalidations, each group in the order it was planned.
+    template <class F>
+    void apply_due(unsigned long long cycle, F&& apply) {
+        vector<int>& bucket = wheel[cycle & mask];
+        if (bucket.empty()) return;
+        for (int h : bucket)
+            if (pool[h].pc.type == STATE_TRANSITION) apply(pool[h].pc);
+        for (int h : bucket)
+            if (pool[h].pc.type == INVALIDATION) apply(pool[h].pc);
+        for (int h : bucket) release(h);
+        count -= bucket.size();
+        bucket.clear();
+    }
+
+    // Earliest apply cycle at or after `now`, or UINT64_MAX if none.
+    unsigned long long next_cycle(unsigned long long now) const {
+        if (count == 0) return UINT64_MAX;
+        for (unsigned long long t = now; t <= now + mask; t++)
+            if (!wheel[t & mask].empty()) return t;
+        return UINT64_MAX;
+    }
+
+    // Writes or reads every outstanding change in the order it was planned.
+    // Pushing them back in that order restores the order they apply in.
+    template <class IO>
+    void serialize(IO& io) {
+        vector<int> order;
+        for (const vector<int>& bucket : wheel) order.insert(order.end(), bucket.begin(), bucket.end());
+        sort(order.begin(), order.end(), [&](int x, int y) { return pool[x].seq < pool[y].seq; });
+        uint64_t n = order.size();
+        io(n);
+        for (uint64_t k = 0; k < n && io.good(); k++) {
+            PlannedChange pc = IO::loading ? PlannedChange() : pool[order[k]].pc;
+            ::serialize(io, pc);
+            if (IO::loading && io.good()) push(pc, pc.apply_cycle - 1);
+        }
+    }
+
+    // Outstanding changes for (core, set), newest first.
+    int first(int core, unsigned int set) const { return heads[slot(core, set)]; }
+    int next(int h) const { return pool[h].next; }
+    const PlannedChange& at(int h) const { return pool[h].pc; }
+    unsigned long long seq(int h) const { return pool[h].seq; }
+
+private:
+    int sets;
+    unsigned long long mask;
+    vector<vector<int>> wheel;
+    vector<Node> pool;
+    vector<int> heads;
+    int free_head;
+    size_t count;
+    unsigned long long next_seq;
+
+    size_t slot(int core, unsigned int set) const { return size_t(core) * sets + set; }
+
+    int alloc() {
+        if (free_head < 0) {
+            pool.push_back(Node());
+            return int(pool.size()) - 1;
+        }
+        int h = free_head;
+        free_head = pool[h].next;
+        return h;
+    }
+
+    void release(int h) {
+        Node& n = pool[h];
+        if (n.prev >= 0)
+            pool[n.prev].next = n.next;
+        else
+            heads[slot(n.pc.core, n.pc.set)] = n.next;
+        if (n.next >= 0) pool[n.next].prev = n.prev;
+        n.next = free_head;
+        free_head = h;
+    }
+};
+
+// In-flight fills ordered by completion cycle; fills that complete in the same
+// cycle come out in the order they were issued.
+struct PendingQueue {
+    PendingQueue() : next_seq(0) {}
+
+    bool empty() const { return heap.empty(); }
+
+    void push(const PendingAllocation& pa) {
+        heap.push_back({pa, next_seq++});
+        push_heap(heap.begin(), heap.end(), later);
+    }
+
+    unsigned long long next_cycle() const {
+        return heap.empty() ? UINT64_MAX : heap.front().pa.complete_cycle;
+    }
+
+    // Visits every in-flight fill, in no particular order.
+    template <class F>
+    void for_each(F&& visit) const {
+        for (const Entry& e : heap) visit(e.pa);
+    }
+
+    // Writes or reads the in-flight fills in the order they complete.
+    template <class IO>
+    void serialize(IO& io) {
+        vector<Entry> order = heap;
+        sort(order.begin(), order.end(), [](const Entry& x, const Entry& y) { return later(y, x); });
+        uint64_t n = order.size();
+        io(n);
+        for (uint64_t k = 0; k < n && io.good(); k++) {
+            PendingAllocation pa = IO::loading ? PendingAllocation() : order[k].pa;
+            ::serialize(io, pa);
+            if (IO::loading && io.good()) push(pa);
+        }
+    }
+
+    // Hands every fill complete by `cycle` to `install`.
+    template <class F>
+    void drain(unsigned long long cycle, F&& install) {
+        while (!heap.empty() && heap.front().pa.complete_cycle <= cycle) {
+            pop_heap(heap.begin(), heap.end(), later);
+            install(heap.back().pa);
+            heap.pop_back();
+        }
+    }
+
+private:
+    struct Entry {
+        PendingAllocation pa;
+        unsigned long long seq;
+    };
+    static bool later(const Entry& a, const Entry& b) {
+        if (a.pa.complete_cycle != b.pa.complete_cycle)
+            return a.pa.complete_cycle > b.pa.complete_cycle;
+        return a.seq > b.seq;
+    }
+    vector<Entry> heap;
+    unsigned long long next_seq;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef HOTSPOT_HPP
+#define HOTSPOT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+using namespace std;
+
+// Coherence hotspots (--hotspots): per block, the bus events that coherence
+// costs, and which cores wrote which words of it through the bus. Only the
+// issue loop's bus paths record anything, so hits cost nothing.
+struct BlockHeat {
+    static const int WORDS = 16;  // 4-byte words tracked; larger blocks fold onto them
+
+    unsigned int block = 0;  // address >> b
+    unsigned long long invalidations = 0;  // copies in other caches invalidated
+    unsigned long long upgrades = 0;       // S -> M on a write hit
+    unsigned long long transfers = 0;      // M in one cache -> M in another
+    unsigned long long wb_stalls = 0;      // stalls of a remote M holder writing back
+    unsigned long long stall_cycles = 0;
+    uint64_t writers = 0;       // cores (mod 64) that wrote through the bus
+    uint16_t written = 0;       // words written
+    uint16_t contested = 0;     // words written by more than one core
+    uint16_t last[WORDS] = {};  // last writer of each word, plus one
+
+    unsigned long long events() const { return invalidations + upgrades + transfers + wb_stalls; }
+
+    // Writes from several cores that never touched the same word.
+    bool false_sharing() const { return __builtin_popcountll(writers) > 1 && contested == 0; }
+
+    void write(int core, unsigned int offset) {
+        int w = (offset >> 2) % WORDS;
+        uint16_t who = uint16_t(core + 1);
+        if ((written >> w & 1) && last[w] != who) contested |= uint16_t(1u << w);
+        written |= uint16_t(1u << w);
+        last[w] = who;
+        writers |= uint64_t(1) << (core & 63);
+    }
+};
+
+// Open addressing with linear probing, keyed by block; entries are only
+// ever added, for blocks that had a coherence event. Empty until the first.
+class HotspotTable {
+public:
+    BlockHeat& at(unsigned int block) {
+        if ((used + 1) * 2 > slots.size()) rehash(max<size_t>(1024, slots.size() * 2));
+        size_t i = home(block);
+        while (full[i] && slots[i].block != block) i = (i + 1) & slot_mask;
+        if (!full[i]) {
+            full[i] = true;
+            slots[i].block = block;
+            used++;
+        }
+        return slots[i];
+    }
+
+    size_t size() const { return used; }
+
+    // The k blocks with the most events, most first.
+    vector<BlockHeat> top_blocks(size_t k) const { return top(entries(), k); }
+
+    // The k blocks with the most events among those that look falsely shared.
+    vector<BlockHeat> top_false_sharing(size_t k) const {
+        vector<BlockHeat> v;
+        for (const BlockHeat& h : entries())
+            if (h.false_sharing()) v.push_back(h);
+        return top(v, k);
+    }
+
+    // The events of the blocks in each set, summed; the k sets with the most.
+    vector<BlockHeat> top_sets(size_t k, int s) const {
+        map<unsigned int, BlockHeat> sets;
+        for (const BlockHeat& h : entries()) {
+            unsigned int set = h.block & ((1u << s) - 1);
+            BlockHeat& t = sets[set];
+            t.block = set;
+            t.invalidations += h.invalidations;
+            t.upgrades += h.upgrades;
+            t.transfers += h.transfers;
+            t.wb_stalls += h.wb_stalls;
+            t.stall_cycles += h.stall_cycles;
+            t.writers |= h.writers;
+        }
+        vector<BlockHeat> v;
+        for (const auto& kv : sets) v.push_back(kv.second);
+        return top(v, k);
+    }
+
+private:
+    vector<BlockHeat> slots;
+    vector<bool> full;
+    size_t used = 0, slot_mask = 0;
+
+    size_t home(unsigned int block) const {
+        return size_t((block * 0x9E3779B97F4A7C15ull) >> 32) & slot_mask;
+    }
+
+    void rehash(size_t n) {
+        vector<BlockHeat> old = entries();
+        slots.assign(n, BlockHeat());
+        full.assign(n, false);
+        slot_mask = n - 1;
+        for (const BlockHeat& h : old) {
+            size_t i = home(h.block);
+            while (full[i]) i = (i + 1) & slot_mask;
+            slots[i] = h;
+            full[i] = true;
+        }
+    }
+
+    vector<BlockHeat> entries() const {
+        vector<BlockHeat> v;
+        v.reserve(used);
+        for (size_t i = 0; i < slots.size(); i++)
+            if (full[i]) v.push_back(slots[i]);
+        return v;
+    }
+
+    static vector<BlockHeat> top(vector<BlockHeat> v, size_t k) {
+        auto hotter = [](const BlockHeat& x, const BlockHeat& y) {
+            if (x.events() != y.events()) return x.events() > y.events();
+            return x.block < y.block;
+        };
+        k = min(k, v.size());
+        partial_sort(v.begin(), v.begin() + k, v.end(), hotter);
+        v.resize(k);
+        return v;
+    }
+};
+
+#endif
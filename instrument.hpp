@@ -0,0 +1,135 @@
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// Instrumentation of the simulation loop: call counts and (when asked for)
+// timings of its phases, plus per-core histograms of miss latency and of
+// cycles spent waiting for the bus. Build with -DL1SIM_PROFILE=0 (make
+// PROFILE=0) to compile every hook out; the loop then carries no trace of it.
+#ifndef L1SIM_PROFILE
+#define L1SIM_PROFILE 1
+#endif
+
+enum Phase {
+    PHASE_APPLY,        // planned-change application
+    PHASE_DRAIN,        // pending-allocation drain
+    PHASE_WINDOW,       // --parallel windows
+    PHASE_ISSUE,        // per-core issue (includes the snoops)
+    PHASE_SNOOP,        // snoop probes
+    PHASE_STALL_MERGE,  // stall-request merge
+    PHASE_COUNT
+};
+
+inline const char* phase_name(int p) {
+    static const char* names[] = {"apply", "drain", "window", "issue", "snoop", "stall_merge"};
+    return names[p];
+}
+
+// Power-of-two buckets: bucket 0 counts zeros, bucket k values in
+// [2^(k-1), 2^k).
+struct Histogram {
+    vector<unsigned long long> buckets;
+
+    void add(unsigned long long v) {
+        size_t k = v == 0 ? 0 : 64 - __builtin_clzll(v);
+        if (k >= buckets.size()) buckets.resize(k + 1, 0);
+        buckets[k]++;
+    }
+    unsigned long long count() const {
+        unsigned long long n = 0;
+        for (unsigned long long b : buckets) n += b;
+        return n;
+    }
+};
+
+#if L1SIM_PROFILE
+
+#define PROFILE(stmt) stmt
+#define PROFILE_PHASE(prof, phase) PhaseTimer phase_timer_(prof, phase)
+
+struct Profile {
+    static constexpr unsigned long long NONE = UINT64_MAX;
+
+    bool enabled = false, timing = false;
+    unsigned long long calls[PHASE_COUNT] = {};
+    unsigned long long ticks[PHASE_COUNT] = {};
+    double seconds_per_tick = 0;
+    vector<Histogram> miss_latency, bus_wait;
+    // First cycle each core found the bus busy for its current request.
+    vector<unsigned long long> waiting_since;
+
+    void init(int cores, bool timers) {
+        enabled = true;
+        timing = timers;
+        miss_latency.assign(cores, Histogram());
+        bus_wait.assign(cores, Histogram());
+        waiting_since.assign(cores, NONE);
+        wall0 = chrono::steady_clock::now();
+        tick0 = now();
+    }
+    void finish() {
+        double wall = chrono::duration<double>(chrono::steady_clock::now() - wall0).count();
+        unsigned long long t = now() - tick0;
+        seconds_per_tick = t ? wall / t : 0;
+    }
+
+    void bus_denied(int c, unsigned long long cycle) {
+        if (waiting_since[c] == NONE) waiting_since[c] = cycle;
+    }
+    // Records the wait that ends at `cycle` and returns when it began.
+    unsigned long long bus_granted(int c, unsigned long long cycle) {
+        unsigned long long since = waiting_since[c] == NONE ? cycle : waiting_since[c];
+        waiting_since[c] = NONE;
+        bus_wait[c].add(cycle - since);
+        return since;
+    }
+
+    static unsigned long long now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now().time_since_epoch())
+            .count();
+#endif
+    }
+
+private:
+    chrono::steady_clock::time_point wall0;
+    unsigned long long tick0 = 0;
+};
+
+// Counts one entry into a phase and, if timing, adds its duration.
+struct PhaseTimer {
+    PhaseTimer(Profile& p, Phase ph) : p(p), ph(ph), t0(p.timing ? Profile::now() : 0) {
+        p.calls[ph]++;
+    }
+    ~PhaseTimer() {
+        if (p.timing) p.ticks[ph] += Profile::now() - t0;
+    }
+    Profile& p;
+    Phase ph;
+    unsigned long long t0;
+};
+
+#else
+
+#define PROFILE(stmt)
+#define PROFILE_PHASE(prof, phase)
+
+struct Profile {
+    static const bool enabled = false;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <vector>
+#include "simulate.hpp"
+
+using namespace std;
+
+typedef SimResult (*SimKernel)(const SimConfig&, vector<TraceFile>&);
+
+// LRU kernels specialised for s in 4..8, E in 1, 2, 4, 8, 16 and b in 4..6,
+// the geometries most runs use. Returns null for any other geometry.
+inline SimKernel specialised_kernel(int s, int E, int b) {
+#define KERNEL_B(S, E) \
+    { &simulate_with<LRUPolicy, S, E, 4>, &simulate_with<LRUPolicy, S, E, 5>, \
+      &simulate_with<LRUPolicy, S, E, 6> }
+#define KERNEL_E(S) \
+    { KERNEL_B(S, 1), KERNEL_B(S, 2), KERNEL_B(S, 4), KERNEL_B(S, 8), KERNEL_B(S, 16) }
+    static const SimKernel table[5][5][3] = {
+        KERNEL_E(4), KERNEL_E(5), KERNEL_E(6), KERNEL_E(7), KERNEL_E(8)};
+#undef KERNEL_E
+#undef KERNEL_B
+    if (s < 4 || s > 8 || b < 4 || b > 6 || E < 1 || E > 16 || (E & (E - 1))) return nullptr;
+    return table[s - 4][__builtin_ctz(E)][b - 4];
+}
+
+#endif
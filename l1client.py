@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Sends jobs to an L1simulate --serve socket and prints the reports.
+
+usage: l1client.py [-S socket] <job arguments...>
+       l1client.py [-S socket] --batch <file|->
+
+With job arguments (e.g. -t traces/app1 -s 6 -E 4 -b 5) runs that one job
+and prints its report. With --batch, sends every line of the file as a job
+at once and prints each report after a "### <id>" line, in the order they
+finish; a job that failed gets "### <id> ERR <message>" instead. The exit
+status is 1 if any job failed.
+"""
+
+import socket
+import sys
+
+
+def responses(sock):
+    """Yields (id, ok, report or message) as the server answers."""
+    f = sock.makefile("rb")
+    while True:
+        head = f.readline()
+        if not head:
+            return
+        status, job_id, rest = head.decode().rstrip("\n").split(" ", 2)
+        if status == "OK":
+            yield job_id, True, f.read(int(rest)).decode()
+        else:
+            yield job_id, False, rest
+
+
+def main(argv):
+    path = "l1sim.sock"
+    if len(argv) >= 2 and argv[0] == "-S":
+        path, argv = argv[1], argv[2:]
+    batch = len(argv) == 2 and argv[0] == "--batch"
+    if batch:
+        src = sys.stdin if argv[1] == "-" else open(argv[1])
+        jobs = [line.strip() for line in src if line.strip()]
+    elif argv:
+        jobs = [" ".join(argv)]
+    else:
+        sys.stderr.write(__doc__)
+        return 1
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    sock.sendall("".join(job + "\n" for job in jobs).encode())
+    sock.shutdown(socket.SHUT_WR)
+
+    failed = False
+    for job_id, ok, text in responses(sock):
+        failed |= not ok
+        if batch:
+            sys.stdout.write("### %s\n%s" % (job_id, text) if ok else "### %s ERR %s\n" % (job_id, text))
+        elif ok:
+            sys.stdout.write(text)
+        else:
+            sys.stderr.write(text + "\n")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
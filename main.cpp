@@ -1,404 +1,355 @@
-#include <algorithm>
-#include <cstdint>
-#include <deque>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
 #include <vector>
 #include <string>
-#include <map>
-#include <chrono>
-#include "cache.hpp"
-#include "bus.hpp"
+#include <thread>
+#include "serve.hpp"
+#include "simulator.hpp"
+#include "sweep.hpp"
+#include "stackdist.hpp"
 
 using namespace std;
 
-struct Stats {
-    unsigned long long instr = 0, reads = 0, writes = 0;
-    unsigned long long execution_cycles = 0, idle = 0;
-    unsigned long long misses = 0, evictions = 0, writebacks = 0;
-    unsigned long long invalidations = 0, traffic = 0;
-    unsigned long long bus_transactions = 0;
-    bool waiting_for_own_request = false;
-};
-
-  struct Ref {
-    char type;
-    unsigned int addr;
-};
-
-// Function to format address for debug output
-string format_addr(unsigned int addr, int s, int b) {
-    stringstream ss;
-    ss << "0x" << hex << addr << " (tag:0x" << (addr >> (s + b))
-       << ", set:" << dec << ((addr >> b) & ((1u << s) - 1))
-       << ", offset:" << (addr & ((1u << b) - 1)) << ")";
-    return ss.str();
-}
-
 int main(int argc, char* argv[]) {
-    vector<string> traces(4);
     string pref;
-    int s = 5, E = 2, b = 5;
-    string outfn;
+    vector<int> s_vals = {5}, e_vals = {2}, b_vals = {5};
+    bool s_given = false, e_given = false, b_given = false, r_given = false;
+    bool buses_given = false, arb_given = false;
+    string outfn, jsonfn, sweepfn, stackfn, seriesfn, checkpointfn, restorefn, checkpoint_at;
+    string servefn;
+    size_t cache_mb = 1024;
+    unsigned long long interval = 0;
+    size_t window = 0;
+    unsigned threads = thread::hardware_concurrency();
+    SimConfig cfg;
+    cfg.cores = 0;
 
     for (int i = 1; i < argc; i++) {
         string a = argv[i];
         if (a == "-t" && i + 1 < argc)
             pref = argv[++i];
-        else if (a == "-s" && i + 1 < argc)
-            s = stoi(argv[++i]);
-        else if (a == "-E" && i + 1 < argc)
-            E = stoi(argv[++i]);
-        else if (a == "-b" && i + 1 < argc)
-            b = stoi(argv[++i]);
-        else if (a == "-o" && i + 1 < argc)
+        else if ((a == "-s" || a == "-E" || a == "-b") && i + 1 < argc) {
+            vector<int>& vals = a == "-s" ? s_vals : a == "-E" ? e_vals : b_vals;
+            s_given |= a == "-s";
+            e_given |= a == "-E";
+            b_given |= a == "-b";
+            if (!parse_values(argv[++i], vals)) {
+                cerr << "Bad value for " << a << ": " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (a == "-o" && i + 1 < argc)
             outfn = argv[++i];
+        else if (a == "-j" && i + 1 < argc)
+            jsonfn = argv[++i];
+        else if (a == "-r" && i + 1 < argc) {
+            string r = argv[++i];
+            r_given = true;
+            if (r == "lru")
+                cfg.replacement = REPL_LRU;
+            else if (r == "plru")
+                cfg.replacement = REPL_PLRU;
+            else if (r == "srrip")
+                cfg.replacement = REPL_SRRIP;
+            else if (r == "brrip")
+                cfg.replacement = REPL_BRRIP;
+            else {
+                cerr << "Unknown replacement policy: " << r << "\n";
+                return 1;
+            }
+        } else if (a == "-p" && i + 1 < argc)
+            cfg.cores = stoi(argv[++i]);
+        else if (a == "-w" && i + 1 < argc)
+            window = stoul(argv[++i]);
+        else if (a == "--sweep" && i + 1 < argc)
+            sweepfn = argv[++i];
+        else if (a == "--stack-distance" && i + 1 < argc)
+            stackfn = argv[++i];
+        else if (a == "--interval" && i + 1 < argc)
+            interval = stoull(argv[++i]);
+        else if (a == "--series" && i + 1 < argc)
+            seriesfn = argv[++i];
+        else if (a == "--checkpoint-at" && i + 1 < argc)
+            checkpoint_at = argv[++i];
+        else if (a == "--checkpoint" && i + 1 < argc)
+            checkpointfn = argv[++i];
+        else if (a == "--restore" && i + 1 < argc)
+            restorefn = argv[++i];
+        else if (a == "--sample" && i + 1 < argc)
+            cfg.sample_period = stoull(argv[++i]);
+        else if (a == "--sample-size" && i + 1 < argc)
+            cfg.sample_size = stoull(argv[++i]);
+        else if (a == "--sample-warmup" && i + 1 < argc)
+            cfg.sample_warmup = stoull(argv[++i]);
+        else if (a == "--hotspots" && i + 1 < argc)
+            cfg.hotspots = stoul(argv[++i]);
+        else if (a == "--buses" && i + 1 < argc) {
+            buses_given = true;
+            cfg.buses = stoi(argv[++i]);
+        }
+        else if (a == "--arbitration" && i + 1 < argc) {
+            arb_given = true;
+            if (!parse_arbitration(argv[++i], cfg.arbitration)) {
+                cerr << "Unknown arbitration: " << argv[i] << "\n";
+                return 1;
+            }
+        }
+        else if (a == "--serve" && i + 1 < argc)
+            servefn = argv[++i];
+        else if (a == "--cache-mb" && i + 1 < argc)
+            cache_mb = stoul(argv[++i]);
+        else if (a == "--threads" && i + 1 < argc)
+            threads = stoul(argv[++i]);
+        else if (a == "--parallel")
+            cfg.parallel = true;
+        else if (a == "--no-skip")
+            cfg.event_skip = false;
+        else if (a == "--no-batch")
+            cfg.batch = false;
+        else if (a == "--generic")
+            cfg.generic = true;
+        else if (a == "--no-simd")
+            cfg.tag_match = MATCH_SCALAR;
+        else if (a == "--snoop-filter")
+            cfg.snoop_filter = true;
+        else if (a == "--check-snoop")
+            cfg.snoop_filter = cfg.check_snoop = true;
         else if (a == "-h") {
             cout << "-t <tracefile>: name of parallel application\n";
             cout << "-s <s>: number of set index bits\n";
             cout << "-E <E>: associativity\n";
             cout << "-b <b>: number of block bits\n";
             cout << "-o <outfilename>: logs output\n";
+            cout << "-j <out.json>: also write the statistics, phase timings and latency histograms as JSON\n";
+            cout << "-r <lru|plru|srrip|brrip>: replacement policy (default: lru)\n";
+            cout << "-p <cores>: number of cores (default: one per _procN.trace file found)\n";
+            cout << "-w <refs>: stream each trace, keeping at most <refs> references in memory per core\n";
+            cout << "--sweep <out.csv|out.json>: simulate every combination of the -s/-E/-b lists\n";
+            cout << "    (e.g. -s 4-8 -E 1,2,4) and write one row per configuration and core\n";
+            cout << "--stack-distance <out.csv|out.json>: miss rates of every -s/-E/-b combination\n";
+            cout << "    from one pass per trace, ignoring coherence (default -s 0-12 -E 1,2,4,...,32)\n";
+            cout << "--interval <N>: report peak and average bus utilisation over N-cycle intervals\n";
+            cout << "--series <out.csv|out.bin>: with --interval, write bus and per-core activity per interval\n";
+            cout << "--checkpoint-at <cycle|<refs>r>: save the simulation state at that cycle, or once\n";
+            cout << "    that many references are done (e.g. 500000r), and carry on\n";
+            cout << "--checkpoint <file>: where --checkpoint-at saves (default: <tracefile>.ckpt)\n";
+            cout << "--restore <file>: continue the run saved in a checkpoint (same traces and\n";
+            cout << "    -s/-E/-b/-r/-p/--buses/--arbitration)\n";
+            cout << "--sample <P>: simulate in detail only a window at the start of every P cycles,\n";
+            cout << "    warm the caches functionally for the rest and extrapolate\n";
+            cout << "--sample-size <U>: cycles measured per window (default: 10000)\n";
+            cout << "--sample-warmup <W>: detailed cycles before each measurement (default: 2000)\n";
+            cout << "--hotspots <K>: list the K blocks and sets with the most coherence events\n";
+            cout << "    and the blocks that look falsely shared\n";
+            cout << "--buses <n>: n snooping buses, each serving the blocks whose number is its\n";
+            cout << "    index modulo n (default: 1)\n";
+            cout << "--arbitration <fixed|round-robin|oldest-first>: which core gets a bus several\n";
+            cout << "    want in the same cycle (default: fixed, the lowest-numbered core)\n";
+            cout << "--serve <socket|->: run jobs sent on a Unix domain socket, or on stdin with\n";
+            cout << "    results on stdout (see README); uses --threads workers\n";
+            cout << "--cache-mb <n>: memory for parsed traces kept between --serve jobs (default: 1024)\n";
+            cout << "--parallel: retire the batches of private hits on --threads threads\n";
+            cout << "--threads <n>: worker threads for --sweep and --parallel (default: all hardware threads)\n";
+            cout << "--no-skip: advance one cycle at a time instead of jumping to the next event\n";
+            cout << "--no-batch: retire private hits one cycle at a time instead of in batches\n";
+            cout << "    between bus transactions\n";
+            cout << "--generic: always use the kernel that reads the geometry at run time\n";
+            cout << "--no-simd: compare tags one way at a time instead of with SSE2/AVX2\n";
+            cout << "--snoop-filter: probe only the caches a sharer directory says hold the block\n";
+            cout << "--check-snoop: use the snoop filter and check it against probing every cache\n";
             cout << "-h: prints this help\n";
             return 0;
         }
     }
 
-    for (int i = 0; i < 4; i++) {
-        traces[i] = pref + "_proc" + to_string(i) + ".trace";
-    }
+    if (!servefn.empty()) return serve(servefn, threads, cache_mb << 20);
 
-    vector<deque<Ref>> refq(4);
-    for (int c = 0; c < 4; c++) {
-        ifstream f(traces[c]);
-        if (!f) {
-            cerr << "Cannot open " << traces[c] << "\n";
-            return 1;
+    bool sweep = !sweepfn.empty(), stack = !stackfn.empty();
+    if ((!checkpoint_at.empty() || !restorefn.empty()) && (sweep || stack)) {
+        cerr << "--checkpoint-at and --restore cannot be used with --sweep or --stack-distance\n";
+        return 1;
+    }
+    if (!checkpoint_at.empty()) {
+        size_t used = 0;
+        try {
+            cfg.checkpoint_at = stoull(checkpoint_at, &used);
+        } catch (const exception&) {
         }
-        char t;
-        string addr;
-        while (f >> t >> addr) {
-            unsigned int a = stoul(addr, nullptr, 0);
-            refq[c].push_back({t, a});
+        cfg.checkpoint_refs = used > 0 && used + 1 == checkpoint_at.size() && checkpoint_at[used] == 'r';
+        if (used == 0 || (used != checkpoint_at.size() && !cfg.checkpoint_refs)) {
+            cerr << "Bad value for --checkpoint-at: " << checkpoint_at << "\n";
+            return 1;
         }
+        cfg.checkpoint = checkpointfn.empty() ? pref + ".ckpt" : checkpointfn;
     }
-
-    vector<Cache> cache(4, Cache(s, E, b));
-    Bus bus;
-    vector<Stats> st(4);
-    vector<unsigned long long> stall_until(4, 0);
-    unsigned long long global_cycle = 0;
-    vector<PendingAllocation> pending_allocations;
-    vector<PlannedChange> planned_changes;
-    vector<StallRequest> stall_requests;
-
-    auto get_set = [&](unsigned int addr) { return (addr >> b) & ((1u << s) - 1); };
-    auto get_tag = [&](unsigned int addr) { return addr >> (s + b); };
-    auto block_words = (1u << b) / 4u;
-
-    auto start_time = chrono::high_resolution_clock::now();
-    while (true) {
-        bool done = true;
-        for (int c = 0; c < 4; c++) {
-            if (!refq[c].empty() || global_cycle < stall_until[c]) {
-                done = false;
-                break;
-            }
+    if (cfg.sample_period) {
+        if (cfg.sample_size == 0 || cfg.sample_period < cfg.sample_size + cfg.sample_warmup) {
+            cerr << "--sample needs a period of at least --sample-size + --sample-warmup\n";
+            return 1;
         }
-        if (done && pending_allocations.empty() && planned_changes.empty()) break;
-        vector<PlannedChange> next_planned_changes;
-        for (auto& pc : planned_changes) {
-            if (pc.apply_cycle <= global_cycle) {
-                if (pc.type == STATE_TRANSITION) {
-                    Cache& C = cache[pc.core];
-                    C.sets[pc.set][pc.idx].valid = pc.valid;
-                    C.sets[pc.set][pc.idx].state = pc.state;
-                    C.sets[pc.set][pc.idx].tag = pc.tag;
-                    C.sets[pc.set][pc.idx].last_used = pc.last_used;
-                }
-            } else {
-                next_planned_changes.push_back(pc);
-            }
+        if (sweep || stack || cfg.parallel || interval || !checkpoint_at.empty() ||
+            !restorefn.empty() || cfg.hotspots) {
+            cerr << "--sample cannot be combined with --sweep, --stack-distance, --parallel,\n"
+                    "--interval, --checkpoint-at, --restore or --hotspots\n";
+            return 1;
         }
-        for (auto& pc : planned_changes) {
-            if (pc.apply_cycle <= global_cycle && pc.type == INVALIDATION) {
-                Cache& C = cache[pc.core];
-                //C.sets[pc.set][pc.idx].valid = pc.valid;
-                C.sets[pc.set][pc.idx].state = pc.state;
-                // C.sets[pc.set][pc.idx].tag = pc.tag;
-                // C.sets[pc.set][pc.idx].last_used = pc.last_used;
-            }
+    }
+    if (cfg.buses < 1 || cfg.buses > 1024) {
+        cerr << "--buses must be between 1 and 1024\n";
+        return 1;
+    }
+    if (cfg.buses > 1 && cfg.sample_period) {
+        cerr << "--buses cannot be combined with --sample\n";
+        return 1;
+    }
+    if (cfg.hotspots && (sweep || stack)) {
+        cerr << "--hotspots cannot be combined with --sweep or --stack-distance\n";
+        return 1;
+    }
+    if (!restorefn.empty()) {
+        // The checkpoint fixes the configuration; options that disagree with
+        // it are an error rather than silently ignored.
+        CheckpointHeader h;
+        string err;
+        if (!read_checkpoint_header(restorefn, h, err)) {
+            cerr << err << "\n";
+            return 1;
         }
-        planned_changes = next_planned_changes;
-
-        auto now_pending = std::move(pending_allocations);
-        pending_allocations.clear();
-        for (auto& pa : now_pending) {
-            if (global_cycle >= pa.complete_cycle) {
-                Cache& C = cache[pa.core];
-                C.sets[pa.set][pa.victim].valid = true;
-                C.sets[pa.set][pa.victim].tag = pa.tag;
-                C.sets[pa.set][pa.victim].state = pa.state;
-                C.touch(pa.set, pa.victim);
-            } else {
-                pending_allocations.push_back(pa);
-            }
+        Replacement r = Replacement(h.replacement);
+        Arbitration arb = Arbitration(h.arbitration);
+        if ((s_given && s_vals[0] != h.s) || (e_given && e_vals[0] != h.E) ||
+            (b_given && b_vals[0] != h.b) || (r_given && cfg.replacement != r) ||
+            (cfg.cores > 0 && cfg.cores != int(h.cores)) ||
+            (buses_given && cfg.buses != int(h.buses)) || (arb_given && cfg.arbitration != arb)) {
+            cerr << restorefn << " was taken with -s " << h.s << " -E " << h.E << " -b " << h.b
+                 << " -r " << replacement_name(r) << " -p " << h.cores << " --buses " << h.buses
+                 << " --arbitration " << arbitration_name(arb) << "\n";
+            return 1;
         }
-
-        for (int c = 0; c < 4; c++) {
-            if (refq[c].empty()) continue;
-            if (global_cycle < stall_until[c]) {
-                if (!st[c].waiting_for_own_request) {
-                    st[c].idle++;
-                } else {
-                    st[c].execution_cycles++;
-                }
-                continue;
+        s_vals = {h.s};
+        e_vals = {h.E};
+        b_vals = {h.b};
+        cfg.replacement = r;
+        cfg.cores = h.cores;
+        cfg.buses = h.buses;
+        cfg.arbitration = arb;
+        cfg.restore = restorefn;
+    }
+    if (!seriesfn.empty() && interval == 0) {
+        cerr << "--series needs --interval <N> with N > 0\n";
+        return 1;
+    }
+    if (interval > MAX_INTERVAL / cfg.buses) {
+        cerr << "--interval times --buses must be below 2^32\n";
+        return 1;
+    }
+    if (stack) {
+        if (!s_given) s_vals = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+        if (!e_given) e_vals = {1, 2, 4, 8, 16, 32};
+        for (int v : e_vals)
+            if (v < 1) {
+                cerr << "Bad associativity for --stack-distance: " << v << "\n";
+                return 1;
             }
+    }
+    if (!sweep && !stack && (s_vals.size() > 1 || e_vals.size() > 1 || b_vals.size() > 1)) {
+        cerr << "Lists of -s/-E/-b values need --sweep or --stack-distance\n";
+        return 1;
+    }
+    if (cfg.replacement == REPL_PLRU)
+        for (int v : e_vals)
+            if (v < 1 || (v & (v - 1))) {
+                cerr << "-r plru needs a power-of-two associativity\n";
+                return 1;
+            }
+    cfg.s = s_vals[0];
+    cfg.E = e_vals[0];
+    cfg.b = b_vals[0];
 
-            st[c].execution_cycles++;
-            
-            Ref R = refq[c].front();
-            unsigned int set = get_set(R.addr), tag = get_tag(R.addr);
-            bool isWrite = (R.type == 'W');
-            Cache& C = cache[c];
-            int idx = C.find_line(tag, set);
-
-            if (idx >= 0 && C.sets[set][idx].state != I) {
-                if (isWrite) {
-                    if (C.sets[set][idx].state == M) {
-                        planned_changes.push_back(
-                            {c, set, idx, true, M, tag, C.use_counter++, global_cycle + 1, STATE_TRANSITION});
-                    } else if (C.sets[set][idx].state == E) {
-                        planned_changes.push_back(
-                            {c, set, idx, true, M, tag, C.use_counter++, global_cycle + 1, STATE_TRANSITION});
-                    } else if (C.sets[set][idx].state == S) {
-                        if (bus.free_at(global_cycle)) {
-                            st[c].bus_transactions++;
-                            bus.occupy(global_cycle, 1);
-                            bool invalidated_others = false;
-                            
-                            for (int o = 0; o < 4; o++) {
-                                if (o != c) {
-                                    int oi = cache[o].find_line(tag, set);
-                                    if (oi >= 0 && cache[o].sets[set][oi].state != I) {
-                                        planned_changes.push_back({o, set, oi, false, I, cache[o].sets[set][oi].tag, 0, global_cycle + 1, INVALIDATION});
-                                        invalidated_others = true;
-                                    }
-                                }
-                            }
-                            if (invalidated_others) {
-                                st[c].invalidations++;
-                            }
-                            
-                            planned_changes.push_back({c, set, idx, true, M, tag, C.use_counter++, global_cycle + 1, STATE_TRANSITION});
-                        } else {
-                            stall_until[c] = bus.busy_until;
-                            continue;
-                        }
-                    }
-                } else { // Read hit
-                    planned_changes.push_back({c, set, idx, true,
-                                               C.sets[set][idx].state, tag,
-                                               C.use_counter++, global_cycle + 1, STATE_TRANSITION});
-                }
-                refq[c].pop_front();
-                st[c].instr++;
-                if (isWrite)
-                    st[c].writes++;
-                else
-                    st[c].reads++;
-            } else { // Cache miss
-                if (!bus.free_at(global_cycle)) {
-                    stall_until[c] = bus.busy_until;
-                    continue;
-                }
-
-                st[c].waiting_for_own_request = true;
-
-                for (int other_c = 0; other_c < 4; other_c++) {
-                    if (other_c != c) {
-                        st[other_c].waiting_for_own_request = false;
-                    }
-                }
-                
-                st[c].misses++;
-                bool isRdX = isWrite;
-                bool found_shared = false, found_mod = false;
-
-                vector<pair<int, int>> other_copies;
-                
-                for (int o = 0; o < 4; o++) {
-                    if (o != c) {
-                        int oi = cache[o].find_line(tag, set);
-                        if (oi >= 0 && cache[o].sets[set][oi].state != I) {
-                            found_shared = true;
-                            other_copies.push_back({o, oi});
-                            
-                            if (cache[o].sets[set][oi].state == M) {
-                                found_mod = true;
-                            }
-                        }
-                    }
-                }
-                
-                for (const auto& pc : planned_changes) {
-                    if (pc.apply_cycle > global_cycle && pc.core != c && 
-                        pc.set == set && pc.tag == tag && pc.valid && pc.state != I) {
-                        found_shared = true;
-                        
-                        bool already_counted = false;
-                        for (const auto& other : other_copies) {
-                            if (other.first == pc.core && other.second == pc.idx) {
-                                already_counted = true;
-                                break;
-                            }
-                        }
-                        
-                        if (!already_counted) {
-                            other_copies.push_back({pc.core, pc.idx});
-                        }
-                        
-                        if (pc.state == M) {
-                            found_mod = true;
-                        }
-                    }
-                }
+    if (cfg.cores <= 0) {
+        cfg.cores = 0;
+        while (ifstream(pref + "_proc" + to_string(cfg.cores) + ".trace")) cfg.cores++;
+        if (cfg.cores == 0) {
+            cerr << "Cannot open " << pref << "_proc0.trace\n";
+            return 1;
+        }
+    }
+    string err;
+    if (!check_config(cfg, err)) {
+        cerr << err << "\n";
+        return 1;
+    }
 
-                State new_state;
-                unsigned long long data_transfer_cycles;
-                bool needs_invalidation = false;
-                
-                if (isRdX) { // Write miss
-                    new_state = State::M; 
-                    
-                    if (found_mod) {
-                        data_transfer_cycles = 200;
-                        
-                        for (const auto& other : other_copies) {
-                            int o = other.first;
-                            int oi = other.second;
-                            
-                            if (cache[o].sets[set][oi].state == M) {
-                                stall_requests.push_back({o, global_cycle + 101});
-                                st[o].traffic += (1u << b);
-                            }
-                            
-                            needs_invalidation = true;
-                        }
-                    } else {
-                        data_transfer_cycles = 101;
-                        st[c].traffic += (1u << b);
-                        
-                        if (!other_copies.empty()) {
-                            needs_invalidation = true;
-                        }
-                    }
-                } else { // Read miss
-                    if (found_shared) {
-                        new_state = S;
-                        data_transfer_cycles = 2 * block_words;
-                        bool data_transferred = false;
-                        for (const auto& other : other_copies) {
-                            int o = other.first;
-                            int oi = other.second;
-                            
-                            bool skip = false;
-                            for (const auto& pc : planned_changes) {
-                                if (pc.core == o && pc.set == set && pc.idx == oi && pc.state == I) {
-                                    skip = true;
-                                    break;
-                                }
-                            }
-                            
-                            if (skip) continue;
-                            
-                            if (!data_transferred && cache[o].sets[set][oi].state != I) {
-                                st[o].traffic += (1u << b);
-                                
-                                if (cache[o].sets[set][oi].state == M) {
-                                    st[o].traffic += (1u << b);
-                                    
-                                    stall_requests.push_back({o, global_cycle + 2 * block_words + 100});
-                                } else {
-                                    stall_requests.push_back({o, global_cycle + 2 * block_words});
-                                }
-                                
-                                data_transferred = true;
-                            }
-                            
-                            planned_changes.push_back(
-                                {o, set, oi, true, S,
-                                 cache[o].sets[set][oi].tag,
-                                 cache[o].sets[set][oi].last_used,
-                                 global_cycle + 1, STATE_TRANSITION});
-                        }
-                        data_transfer_cycles = 2 * block_words;
-                    } else {
-                        new_state = State::E;
-                        data_transfer_cycles = 101;
-                        st[c].traffic += (1u << b);
-                    }
-                }
+    vector<string> traces(cfg.cores);
+    for (int i = 0; i < cfg.cores; i++) {
+        traces[i] = pref + "_proc" + to_string(i) + ".trace";
+    }
 
-                unsigned long long total_bus_cycles = data_transfer_cycles;
-                
-                if (needs_invalidation) {
-                    for (const auto& other : other_copies) {
-                        int o = other.first;
-                        int oi = other.second;
-                        planned_changes.push_back({o, set, oi, false, I, cache[o].sets[set][oi].tag,  0, global_cycle + 1, INVALIDATION});
-                    }
-                    st[c].invalidations++;
-                }
-                
-                int v = C.choose_victim(set);
-                bool needs_writeback = false;
-                
-                if (C.sets[set][v].valid) {
-                    if (C.sets[set][v].state == M) {
-                        needs_writeback = true;
-                        st[c].writebacks++;
-                        st[c].traffic += (1u << b);
-                        total_bus_cycles += 100;
-                    }
-                    if (C.sets[set][v].state != I)
-                        st[c].evictions++;
-                }
+    // Sweeps and stack-distance analysis share one fully loaded copy of each
+    // trace between their runs.
+    vector<TraceFile> refq(sweep || stack ? cfg.cores : 0);
+    for (size_t c = 0; c < refq.size(); c++) {
+        string err;
+        if (!refq[c].open(traces[c], err)) {
+            cerr << err << "\n";
+            return 1;
+        }
+    }
 
-                unsigned long long allocation_completion_cycle = global_cycle + total_bus_cycles;
-                PendingAllocation pa;
-                pa.core = c;
-                pa.set = set;
-                pa.victim = v;
-                pa.tag = tag;
-                pa.state = new_state;
-                pa.complete_cycle = allocation_completion_cycle;
-                
-                pending_allocations.push_back(pa);
-                
-                bus.occupy(global_cycle, total_bus_cycles);
-                stall_until[c] = bus.busy_until;
-                st[c].bus_transactions++;
-            }
+    if (stack) {
+        int max_assoc = *max_element(e_vals.begin(), e_vals.end());
+        vector<StackProfile> profiles = run_stack_profiles(refq, s_vals, b_vals, max_assoc, threads);
+        ofstream f(stackfn);
+        if (!f) {
+            cerr << "Cannot open output file: " << stackfn << "\n";
+            return 1;
         }
+        bool json = stackfn.size() >= 5 && stackfn.compare(stackfn.size() - 5, 5, ".json") == 0;
+        write_stack_table(f, json, pref, profiles, e_vals);
+        return 0;
+    }
 
-        for (const auto& req : stall_requests) {
-            if (global_cycle >= stall_until[req.core]) {
-                stall_until[req.core] = req.until_cycle;
-            } else {
-                stall_until[req.core] = max(stall_until[req.core], stall_until[req.core] + (req.until_cycle - global_cycle));
-            }
+    if (sweep) {
+        vector<SimConfig> configs;
+        vector<SimResult> results = run_sweep(cfg, s_vals, e_vals, b_vals, refq, threads, configs);
+        ofstream f(sweepfn);
+        if (!f) {
+            cerr << "Cannot open output file: " << sweepfn << "\n";
+            return 1;
         }
-        stall_requests.clear();
+        bool json = sweepfn.size() >= 5 && sweepfn.compare(sweepfn.size() - 5, 5, ".json") == 0;
+        write_sweep_table(f, json, pref, configs, results);
+        return 0;
+    }
 
-        global_cycle++;
+    cfg.threads = threads;
+    cfg.timers = !jsonfn.empty();
+    cfg.interval = interval;
+    SeriesWriter series;
+    if (!seriesfn.empty()) {
+        if (!series.open(seriesfn, cfg.cores, interval, err)) {
+            cerr << err << "\n";
+            return 1;
+        }
+        cfg.series = &series;
+    }
+    SimulatorConfig sc;
+    sc.sim = cfg;
+    for (const string& t : traces) sc.traces.push_back(TraceSource::file(t, window));
+    Simulator sim;
+    if (!sim.open(sc, err)) {
+        cerr << err << "\n";
+        return 1;
+    }
+    if (!sim.run()) {
+        cerr << sim.error() << "\n";
+        return 1;
+    }
+    const SimResult& res = sim.result();
+    if (!series.close()) {
+        cerr << "Cannot write " << seriesfn << "\n";
+        return 1;
     }
 
-    auto end_time = chrono::high_resolution_clock::now();
-    chrono::duration<double> elapsed = end_time - start_time;
     ostream* out = &cout;
     if (!outfn.empty()) {
         static ofstream f(outfn);
@@ -408,45 +359,15 @@ int main(int argc, char* argv[]) {
         }
         out = &f;
     }
-    *out << "Simulation Parameters:\n";
-    *out << "Trace Prefix: " << pref << "\n";
-    *out << "Set Index Bits: " << s << "\n";
-    *out << "Associativity: " << E << "\n";
-    *out << "Block Bits: " << b << "\n";
-    *out << "Block Size (Bytes): " << (1 << b) << "\n";
-    *out << "Number of Sets: " << (1 << s) << "\n";
-    *out << "Cache Size (KB per core): " << ((1 << s) * E * (1 << b) / 1024)
-         << "\n";
-    *out << "MESI Protocol: Enabled\n";
-    *out << "Write Policy: Write-back, Write-allocate\n";
-    *out << "Replacement Policy: LRU\n";
-    *out << "Bus: Central snooping bus\n\n";
+    write_report(*out, pref, cfg, res);
 
-    unsigned long long total_bus_tx = 0, total_bus_traffic = 0;
-    for (int c = 0; c < 4; c++) {
-        double miss_rate =
-            st[c].misses / double(st[c].instr) * 100.0;
-        *out << "Core " << c << " Statistics:\n";
-        *out << "Total Instructions: " << st[c].instr << "\n";
-        *out << "Total Reads: " << st[c].reads << "\n";
-        *out << "Total Writes: " << st[c].writes << "\n";
-        *out << "Total Execution Cycles: " << st[c].execution_cycles << "\n";
-        *out << "Idle Cycles: " << st[c].idle << "\n";
-        *out << "Cache Misses: " << st[c].misses << "\n";
-        *out << fixed << setprecision(2) << "Cache Miss Rate: " << miss_rate
-             << "%\n";
-        *out << "Cache Evictions: " << st[c].evictions << "\n";
-        *out << "Writebacks: " << st[c].writebacks << "\n";
-        *out << "Bus Invalidations: " << st[c].invalidations << "\n";
-        *out << "Data Traffic (Bytes): " << st[c].traffic << "\n\n";
-        total_bus_tx += st[c].bus_transactions;
-        total_bus_traffic += st[c].traffic;
+    if (!jsonfn.empty()) {
+        ofstream f(jsonfn);
+        if (!f) {
+            cerr << "Cannot open output file: " << jsonfn << "\n";
+            return 1;
+        }
+        write_json_report(f, pref, cfg, res);
     }
-
-    *out << "Overall Bus Summary:\n";
-    *out << "Total Bus Transactions: " << total_bus_tx << "\n";
-    *out << "Total Bus Traffic (Bytes): " << total_bus_traffic << "\n";
-    *out << "Simulation Run Time (seconds): " << fixed << setprecision(6) << elapsed.count() << "\n";
-    *out << "Total Cycles: " << global_cycle << "\n";
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,152 @@
+#ifndef POLICY_HPP
+#define POLICY_HPP
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Replacement policies for Cache<Policy>. Each keeps its own per-line
+// metadata and is called directly, so choosing one costs nothing per access.
+//
+// Line updates are planned a cycle ahead and carry a recency stamp: access()
+// gives the stamp for a hit and stamp() the one that leaves a line as it is.
+// Only LRU needs real values; the other policies hand out the TOUCHED and
+// UNCHANGED markers and act on them in restamp().
+enum Replacement { REPL_LRU, REPL_PLRU, REPL_SRRIP, REPL_BRRIP };
+
+inline const char* replacement_name(Replacement r) {
+    return r == REPL_PLRU ? "Tree-PLRU" : r == REPL_SRRIP ? "SRRIP" : r == REPL_BRRIP ? "BRRIP" : "LRU";
+}
+
+const unsigned long long TOUCHED = UINT64_MAX, UNCHANGED = UINT64_MAX - 1;
+
+// Evicts the least recently used line, by 64-bit use stamps.
+struct LRUPolicy {
+    static const Replacement kind = REPL_LRU;
+
+    LRUPolicy(int sets, int ways) : A(ways), stamps(size_t(sets) * ways, 0) {}
+
+    unsigned long long stamp(int set, int way) const { return stamps[size_t(set) * A + way]; }
+    unsigned long long access(unsigned long long& counter) { return counter++; }
+    void restamp(int set, int way, unsigned long long used) { stamps[size_t(set) * A + way] = used; }
+    void fill(int set, int way, unsigned long long& counter) {
+        stamps[size_t(set) * A + way] = counter++;
+    }
+    // Every way of the set is valid; `ways` is the associativity again, passed
+    // in so a cache specialised for it can unroll the loop.
+    int victim(int set, int ways) {
+        const unsigned long long* used = &stamps[size_t(set) * A];
+        int victim = 0;
+        unsigned long long min_used = UINT64_MAX;
+        for (int i = 0; i < ways; i++) {
+            if (used[i] < min_used) {
+                min_used = used[i];
+                victim = i;
+            }
+        }
+        return victim;
+    }
+    size_t bytes() const { return stamps.size() * sizeof(unsigned long long); }
+    template <class IO>
+    void serialize(IO& io) { io.vec(stamps); }
+
+private:
+    int A;
+    vector<unsigned long long> stamps;
+};
+
+// Tree pseudo-LRU: A - 1 bits per set, one per node of a binary tree over the
+// ways (heap order, root 1, leaves A..2A-1). A bit points to the half the
+// next victim comes from; an access turns the bits on its path away from it.
+// Needs a power-of-two associativity.
+struct PLRUPolicy {
+    static const Replacement kind = REPL_PLRU;
+
+    PLRUPolicy(int sets, int ways)
+        : A(ways), words((ways + 63) / 64), bits(size_t(sets) * words, 0) {}
+
+    unsigned long long stamp(int, int) const { return UNCHANGED; }
+    unsigned long long access(unsigned long long&) { return TOUCHED; }
+    void restamp(int set, int way, unsigned long long used) {
+        if (used == TOUCHED) point_away(set, way);
+    }
+    void fill(int set, int way, unsigned long long&) { point_away(set, way); }
+    int victim(int set, int ways) const {
+        const uint64_t* b = &bits[size_t(set) * words];
+        int n = 1;
+        while (n < ways) n = 2 * n + int(b[n >> 6] >> (n & 63) & 1);
+        return n - ways;
+    }
+    size_t bytes() const { return bits.size() * sizeof(uint64_t); }
+    template <class IO>
+    void serialize(IO& io) { io.vec(bits); }
+
+private:
+    int A, words;
+    vector<uint64_t> bits;
+
+    void point_away(int set, int way) {
+        uint64_t* b = &bits[size_t(set) * words];
+        for (int n = way + A; n > 1; n >>= 1) {
+            int p = n >> 1;
+            uint64_t m = uint64_t(1) << (p & 63);
+            if (n & 1)
+                b[p >> 6] &= ~m;  // came from the right: next victim on the left
+            else
+                b[p >> 6] |= m;
+        }
+    }
+};
+
+// Re-reference interval prediction with 2-bit values packed four to a byte.
+// Hits predict a near re-reference (0); the victim is the first line with a
+// distant prediction (3), ageing the set until one exists. SRRIP inserts at 2;
+// BRRIP inserts at 3 except for every 32nd fill, which goes in at 2.
+template <bool Bimodal>
+struct RRIPPolicy {
+    static const Replacement kind = Bimodal ? REPL_BRRIP : REPL_SRRIP;
+
+    RRIPPolicy(int sets, int ways)
+        : A(ways), rrpv((size_t(sets) * ways + 3) / 4, 0), fills(0) {}
+
+    unsigned long long stamp(int, int) const { return UNCHANGED; }
+    unsigned long long access(unsigned long long&) { return TOUCHED; }
+    void restamp(int set, int way, unsigned long long used) {
+        if (used == TOUCHED) put(size_t(set) * A + way, 0);
+    }
+    void fill(int set, int way, unsigned long long&) {
+        unsigned v = Bimodal && (fills++ & 31) != 0 ? 3 : 2;
+        put(size_t(set) * A + way, v);
+    }
+    int victim(int set, int ways) {
+        size_t base = size_t(set) * A;
+        while (true) {
+            for (int i = 0; i < ways; i++)
+                if (get(base + i) == 3) return i;
+            for (int i = 0; i < ways; i++) put(base + i, get(base + i) + 1);
+        }
+    }
+    size_t bytes() const { return rrpv.size(); }
+    template <class IO>
+    void serialize(IO& io) {
+        io.vec(rrpv);
+        io(fills);
+    }
+
+private:
+    int A;
+    vector<uint8_t> rrpv;
+    unsigned long long fills;
+
+    unsigned get(size_t i) const { return rrpv[i >> 2] >> ((i & 3) * 2) & 3; }
+    void put(size_t i, unsigned v) {
+        unsigned sh = (i & 3) * 2;
+        rrpv[i >> 2] = uint8_t((rrpv[i >> 2] & ~(3u << sh)) | v << sh);
+    }
+};
+
+typedef RRIPPolicy<false> SRRIPPolicy;
+typedef RRIPPolicy<true> BRRIPPolicy;
+
+#endif
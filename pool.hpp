@@ -0,0 +1,116 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed-size work-stealing thread pool. Each worker has its own task deque:
+// it takes work from the back of its own deque and, when that is empty,
+// steals from the front of the others. Tasks are handed out round-robin.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = thread::hardware_concurrency())
+        : stop(false), queued(0), unfinished(0), next_queue(0) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; i++) queues.emplace_back(new Queue);
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::work, this, i);
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lk(mu);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    unsigned size() const { return unsigned(workers.size()); }
+
+    void submit(function<void()> task) {
+        Queue& q = *queues[next_queue++ % queues.size()];
+        {
+            lock_guard<mutex> lk(q.mu);
+            q.tasks.push_back(std::move(task));
+        }
+        {
+            lock_guard<mutex> lk(mu);
+            queued++;
+            unfinished++;
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished.
+    void wait() {
+        unique_lock<mutex> lk(mu);
+        idle.wait(lk, [&] { return unfinished == 0; });
+    }
+
+private:
+    struct Queue {
+        mutex mu;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+    mutex mu;
+    condition_variable wake, idle;
+    bool stop;
+    size_t queued, unfinished;
+    atomic<size_t> next_queue;
+
+    bool take(unsigned self, function<void()>& task) {
+        {
+            Queue& q = *queues[self];
+            lock_guard<mutex> lk(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& q = *queues[(self + k) % queues.size()];
+            lock_guard<mutex> lk(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(unsigned self) {
+        while (true) {
+            {
+                unique_lock<mutex> lk(mu);
+                wake.wait(lk, [&] { return stop || queued > 0; });
+                if (stop && queued == 0) return;
+                queued--;
+            }
+            // A task is reserved for us, so one of the deques holds it.
+            function<void()> task;
+            while (!take(self, task)) this_thread::yield();
+            task();
+            {
+                lock_guard<mutex> lk(mu);
+                if (--unfinished == 0) idle.notify_all();
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SAMPLING_HPP
+#define SAMPLING_HPP
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Sampled simulation (--sample), after SMARTS. The run is cut into periods
+// of P cycles. The first W + U cycles of a period run through the
+// cycle-level simulation: W to warm up the bus and stall state, then U
+// measured. For the rest, each core applies the references it would have
+// completed, at its measured rate, to the cache contents and MESI states
+// only ("functional warming"), with no time passing.
+//
+// Totals for the skipped references are extrapolated from the measurement
+// before them; the confidence interval comes from the spread of a ratio
+// estimator, (sum of X over the samples) / (sum of their references), over
+// all of them.
+
+// What one core did during one measured window.
+struct Sample {
+    unsigned long long refs = 0, cycles = 0, exec = 0, misses = 0, evictions = 0;
+    unsigned long long writebacks = 0, invalidations = 0, traffic = 0, bus_transactions = 0;
+};
+
+struct Estimate {
+    double total = 0;
+    double ci = 0;   // half-width of the 95% confidence interval; NAN if unknown
+};
+
+// Extrapolates `field` to `population` references. When the samples cover
+// every reference the total is exact and the interval empty.
+inline Estimate estimate(const vector<Sample>& samples, unsigned long long Sample::*field,
+                         unsigned long long population) {
+    Estimate e;
+    double n = samples.size(), refs = 0, sum = 0;
+    for (const Sample& x : samples) {
+        refs += x.refs;
+        sum += x.*field;
+    }
+    if (refs == 0) {
+        e.ci = NAN;
+        return e;
+    }
+    double ratio = sum / refs;
+    e.total = ratio * population;
+    if (refs >= population) return e;
+    if (n < 2) {
+        e.ci = NAN;
+        return e;
+    }
+    // Variance of a ratio estimator over samples of unequal size.
+    double mean_refs = refs / n, dev = 0;
+    for (const Sample& x : samples) {
+        double d = x.*field - ratio * x.refs;
+        dev += d * d;
+    }
+    double var = dev / (n * (n - 1) * mean_refs * mean_refs);
+    e.ci = 1.96 * sqrt(var) * population;
+    return e;
+}
+
+// Per-core extrapolation reported by a sampled run.
+struct SampledCore {
+    unsigned long long samples = 0, detailed_refs = 0, refs = 0;
+    Estimate cycles, misses, traffic;
+};
+
+#endif
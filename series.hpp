@@ -0,0 +1,196 @@
+#ifndef SERIES_HPP
+#define SERIES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Time series written by --interval: one row per interval of N cycles with
+// the interval's first cycle, the cycles the bus was busy (summed over the
+// buses with --buses), the bus transactions, misses and invalidations of all cores, then each core's
+// execution and idle cycles.
+//
+// CSV files get a header line. Any other file is binary: the 32-byte
+// SeriesHeader, then per row the first cycle as a little-endian uint64 and
+// the other columns as uint32. No count in a row can exceed the interval
+// times the number of buses, which is below 2^32 (MAX_INTERVAL).
+struct SeriesHeader {
+    char magic[8];              // "L1SERIES"
+    uint32_t version;
+    uint32_t columns;
+    uint32_t cores;
+    uint32_t reserved;
+    uint64_t interval;
+};
+
+const uint32_t SERIES_VERSION = 1;
+const unsigned long long MAX_INTERVAL = UINT32_MAX;
+
+// Writes rows through its own buffer, so a short interval costs one small
+// copy per row rather than a stream operation per value.
+class SeriesWriter {
+public:
+    ~SeriesWriter() { close(); }
+
+    bool open(const string& path, int cores, unsigned long long interval, string& err) {
+        f = fopen(path.c_str(), "wb");
+        if (!f) {
+            err = "Cannot open output file: " + path;
+            return false;
+        }
+        columns = 5 + 2 * size_t(cores);
+        binary = !(path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0);
+        buf.reserve(BUF_SIZE + 64 * columns);
+        if (binary) {
+            SeriesHeader h;
+            memcpy(h.magic, "L1SERIES", 8);
+            h.version = SERIES_VERSION;
+            h.columns = uint32_t(columns);
+            h.cores = uint32_t(cores);
+            h.reserved = 0;
+            h.interval = interval;
+            buf.insert(buf.end(), (const char*)&h, (const char*)&h + sizeof(h));
+        } else {
+            string head = "cycle,bus_busy,bus_transactions,misses,invalidations";
+            for (int c = 0; c < cores; c++)
+                head += ",core" + to_string(c) + "_exec,core" + to_string(c) + "_idle";
+            buf.insert(buf.end(), head.begin(), head.end());
+            buf.push_back('\n');
+        }
+        return true;
+    }
+
+    // `vals` holds one value per column.
+    void row(const unsigned long long* vals) {
+        if (binary) {
+            uint64_t cycle = vals[0];
+            buf.insert(buf.end(), (const char*)&cycle, (const char*)&cycle + 8);
+            for (size_t i = 1; i < columns; i++) {
+                uint32_t v = uint32_t(vals[i]);
+                buf.insert(buf.end(), (const char*)&v, (const char*)&v + 4);
+            }
+        } else {
+            for (size_t i = 0; i < columns; i++) {
+                char digits[24];
+                int n = 0;
+                unsigned long long v = vals[i];
+                do digits[n++] = char('0' + v % 10); while (v /= 10);
+                while (n) buf.push_back(digits[--n]);
+                buf.push_back(i + 1 < columns ? ',' : '\n');
+            }
+        }
+        if (buf.size() >= BUF_SIZE) flush();
+    }
+
+    bool close() {
+        if (!f) return true;
+        flush();
+        bool ok = !ferror(f);
+        ok &= fclose(f) == 0;
+        f = nullptr;
+        return ok;
+    }
+
+private:
+    static const size_t BUF_SIZE = 1 << 16;
+    FILE* f = nullptr;
+    bool binary = false;
+    size_t columns = 0;
+    vector<char> buf;
+
+    void flush() {
+        if (!buf.empty()) fwrite(buf.data(), 1, buf.size(), f);
+        buf.clear();
+    }
+};
+
+// Cuts a run into intervals. The simulation calls bus() for every bus
+// transaction and close() when it reaches a boundary (and once at the end);
+// the counters of a row are differences of the running Stats totals, so the
+// loop must not account cycles of two intervals in one step.
+template <class Stats>
+struct IntervalSeries {
+    IntervalSeries(unsigned long long interval, int cores, int buses, SeriesWriter* out)
+        : interval(interval), next(interval), out(out), last(cores),
+          vals(5 + 2 * size_t(cores)), busy_from(buses, 0), busy_to(buses, 0) {}
+
+    unsigned long long interval;
+    unsigned long long next;            // the current interval's end
+    unsigned long long busy = 0;        // bus busy cycles over the whole run, all buses
+    unsigned long long peak = 0;        // most busy cycles in one interval
+    unsigned long long peak_start = 0;  // and where that interval began
+
+    // Bus k is busy for [start, start + duration).
+    void bus(int k, unsigned long long start, unsigned long long duration) {
+        busy_from[k] = start;
+        busy_to[k] = start + duration;
+        row_busy += overlap(k);
+    }
+
+    // Ends the current interval at `cycle` (its boundary, or earlier at the
+    // end of the run) and starts the next one there.
+    void close(unsigned long long cycle, const vector<Stats>& st) {
+        unsigned long long tx = 0, misses = 0, inval = 0;
+        for (size_t c = 0; c < st.size(); c++) {
+            tx += st[c].bus_transactions - last[c].bus_transactions;
+            misses += st[c].misses - last[c].misses;
+            inval += st[c].invalidations - last[c].invalidations;
+            vals[5 + 2 * c] = st[c].execution_cycles - last[c].execution_cycles;
+            vals[6 + 2 * c] = st[c].idle - last[c].idle;
+        }
+        vals[0] = start;
+        vals[1] = row_busy;
+        vals[2] = tx;
+        vals[3] = misses;
+        vals[4] = inval;
+        if (out) out->row(vals.data());
+        busy += row_busy;
+        if (row_busy > peak) {
+            peak = row_busy;
+            peak_start = start;
+        }
+        last = st;
+        start = cycle;
+        next = cycle + interval;
+        row_busy = 0;
+        for (size_t k = 0; k < busy_to.size(); k++) row_busy += overlap(k);
+    }
+
+    // Starts mid-run, at `cycle`, as after --restore: the first row runs to
+    // the next multiple of the interval. busy_until holds each bus's.
+    void resume(unsigned long long cycle, const vector<Stats>& st,
+                const vector<unsigned long long>& busy_until) {
+        origin = start = cycle;
+        next = (cycle / interval + 1) * interval;
+        last = st;
+        row_busy = 0;
+        for (size_t k = 0; k < busy_to.size(); k++) {
+            busy_from[k] = cycle;
+            busy_to[k] = max(cycle, busy_until[k]);
+            row_busy += overlap(k);
+        }
+    }
+
+    unsigned long long row_start() const { return start; }
+    unsigned long long origin = 0;      // the first row's first cycle
+
+private:
+    SeriesWriter* out;
+    vector<Stats> last;
+    vector<unsigned long long> vals;
+    unsigned long long start = 0, row_busy = 0;
+    // Each bus's latest transaction; earlier ones ended before it began.
+    vector<unsigned long long> busy_from, busy_to;
+
+    unsigned long long overlap(size_t k) const {
+        unsigned long long lo = max(busy_from[k], start), hi = min(busy_to[k], next);
+        return hi > lo ? hi - lo : 0;
+    }
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef SERVE_HPP
+#define SERVE_HPP
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "pool.hpp"
+#include "simulator.hpp"
+
+using namespace std;
+
+// Server mode (--serve). Clients send one job per line, the arguments of
+// an L1simulate run:
+//
+//     -t <prefix> [-s <s>] [-E <E>] [-b <b>] [-r <policy>] [-p <cores>]
+//        [--buses <n>] [--arbitration <name>] [-j] [--id <tag>]
+//
+// and get back, for each job, either
+//
+//     OK <id> <length>\n<length bytes of report>
+//     ERR <id> <message>\n
+//
+// The report is the text one, or the JSON one with -j. The id is the --id
+// tag, or else the job's line number on the connection, counting from 1.
+// Jobs run concurrently on a fixed pool of workers, so responses come back
+// in the order the jobs finish; a client that sends several jobs at once
+// matches them up by id. Parsed traces stay in a TraceCache between jobs.
+
+// Parsed trace files, least recently used first out once they hold more
+// than `capacity` bytes of references. An entry is keyed by path and is
+// reloaded when the file's modification time or size changes. Jobs hold
+// on to what they were given, so eviction never pulls a trace from under
+// a running simulation.
+class TraceCache {
+public:
+    explicit TraceCache(size_t capacity) : capacity(capacity) {}
+
+    shared_ptr<const vector<Ref>> get(const string& path, string& err) {
+        struct stat sb;
+        if (stat(path.c_str(), &sb) != 0) {
+            err = "Cannot open " + path;
+            return nullptr;
+        }
+        long long mtime = sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+        {
+            lock_guard<mutex> lk(mu);
+            auto it = index.find(path);
+            if (it != index.end() && it->second->mtime == mtime && it->second->size == sb.st_size) {
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->refs;
+            }
+        }
+        // Parse outside the lock; two jobs that miss on the same file at
+        // once both parse it, and the later one's copy is kept.
+        TraceFile f;
+        if (!f.open(path, err)) return nullptr;
+        auto refs = make_shared<const vector<Ref>>(f.begin(), f.begin() + f.size());
+        lock_guard<mutex> lk(mu);
+        auto it = index.find(path);
+        if (it != index.end()) drop(it->second);
+        lru.push_front({path, mtime, sb.st_size, refs});
+        index[path] = lru.begin();
+        bytes += refs->size() * sizeof(Ref);
+        while (bytes > capacity && lru.size() > 1) drop(prev(lru.end()));
+        return refs;
+    }
+
+private:
+    struct Entry {
+        string path;
+        long long mtime;
+        off_t size;
+        shared_ptr<const vector<Ref>> refs;
+    };
+    size_t capacity, bytes = 0;
+    list<Entry> lru;  // most recently used first
+    unordered_map<string, list<Entry>::iterator> index;
+    mutex mu;
+
+    void drop(list<Entry>::iterator e) {
+        bytes -= e->refs->size() * sizeof(Ref);
+        index.erase(e->path);
+        lru.erase(e);
+    }
+};
+
+struct ServeJob {
+    string id, pref;
+    SimConfig cfg;
+    bool json = false;
+};
+
+// Parses a job line. On failure returns false and leaves a message in
+// `err`.
+inline bool parse_job(const string& line, ServeJob& job, string& err) {
+    stringstream ss(line);
+    vector<string> args;
+    for (string a; ss >> a;) args.push_back(a);
+    job.cfg.cores = 0;
+    try {
+        for (size_t i = 0; i < args.size(); i++) {
+            const string& a = args[i];
+            bool has_value = i + 1 < args.size();
+            if (a == "-j") {
+                job.json = true;
+            } else if (!has_value) {
+                err = "Unknown or incomplete option: " + a;
+                return false;
+            } else if (a == "-t") {
+                job.pref = args[++i];
+            } else if (a == "--id") {
+                job.id = args[++i];
+            } else if (a == "-s") {
+                job.cfg.s = stoi(args[++i]);
+            } else if (a == "-E") {
+                job.cfg.E = stoi(args[++i]);
+            } else if (a == "-b") {
+                job.cfg.b = stoi(args[++i]);
+            } else if (a == "-p") {
+                job.cfg.cores = stoi(args[++i]);
+            } else if (a == "--buses") {
+                job.cfg.buses = stoi(args[++i]);
+            } else if (a == "--arbitration") {
+                if (!parse_arbitration(args[++i], job.cfg.arbitration)) {
+                    err = "Unknown arbitration: " + args[i];
+                    return false;
+                }
+            } else if (a == "-r") {
+                const string& r = args[++i];
+                if (r == "lru")
+                    job.cfg.replacement = REPL_LRU;
+                else if (r == "plru")
+                    job.cfg.replacement = REPL_PLRU;
+                else if (r == "srrip")
+                    job.cfg.replacement = REPL_SRRIP;
+                else if (r == "brrip")
+                    job.cfg.replacement = REPL_BRRIP;
+                else {
+                    err = "Unknown replacement policy: " + r;
+                    return false;
+                }
+            } else {
+                err = "Unknown option: " + a;
+                return false;
+            }
+        }
+    } catch (...) {
+        err = "Bad number in job: " + line;
+        return false;
+    }
+    const SimConfig& c = job.cfg;
+    if (job.pref.empty()) {
+        err = "Job has no -t <prefix>";
+        return false;
+    }
+    if (c.s < 0 || c.b < 2 || c.E < 1 || c.s + c.b > 32 || c.cores < 0 || c.cores > 1024 ||
+        c.buses < 1 || c.buses > 1024) {
+        err = "Bad geometry, core or bus count";
+        return false;
+    }
+    if (c.replacement == REPL_PLRU && (c.E & (c.E - 1))) {
+        err = "-r plru needs a power-of-two associativity";
+        return false;
+    }
+    return true;
+}
+
+// Runs one job on traces from `cache` and returns its report.
+inline bool run_job(const ServeJob& job, TraceCache& cache, string& report, string& err) {
+    int cores = job.cfg.cores;
+    if (cores == 0)
+        while (ifstream(job.pref + "_proc" + to_string(cores) + ".trace")) cores++;
+    if (cores == 0) {
+        err = "Cannot open " + job.pref + "_proc0.trace";
+        return false;
+    }
+    vector<shared_ptr<const vector<Ref>>> refs(cores);
+    SimulatorConfig sc;
+    sc.sim = job.cfg;
+    sc.sim.cores = cores;
+    for (int c = 0; c < cores; c++) {
+        refs[c] = cache.get(job.pref + "_proc" + to_string(c) + ".trace", err);
+        if (!refs[c]) return false;
+        sc.traces.push_back(TraceSource::memory(*refs[c]));
+    }
+    Simulator sim;
+    if (!sim.open(sc, err)) return false;
+    if (!sim.run()) {
+        err = sim.error();
+        return false;
+    }
+    stringstream out;
+    if (job.json)
+        write_json_report(out, job.pref, sim.config(), sim.result());
+    else
+        write_report(out, job.pref, sim.config(), sim.result());
+    report = out.str();
+    return true;
+}
+
+// One client. Workers answer through it, each response written whole; the
+// descriptors are closed (unless they are stdin and stdout) once the
+// reader and every job of the client are done with it.
+struct ServeClient {
+    int in, out;
+    bool owned;
+    mutex mu;
+
+    ServeClient(int in, int out, bool owned) : in(in), out(out), owned(owned) {}
+    ~ServeClient() {
+        if (owned) close(in);
+    }
+
+    void send(const string& msg) {
+        lock_guard<mutex> lk(mu);
+        for (size_t done = 0; done < msg.size();) {
+            ssize_t n = write(out, msg.data() + done, msg.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;  // the client went away; its jobs still finish
+            done += n;
+        }
+    }
+};
+
+// Reads the client's jobs until it closes its end and hands each to `pool`.
+inline void serve_client(shared_ptr<ServeClient> client, ThreadPool& pool, TraceCache& cache) {
+    string buf;
+    char chunk[4096];
+    unsigned long long line_no = 0;
+    for (;;) {
+        size_t nl;
+        while ((nl = buf.find('\n')) == string::npos) {
+            ssize_t n = read(client->in, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (buf.empty()) return;
+                buf += '\n';  // a last job without a newline
+                break;
+            }
+            buf.append(chunk, n);
+        }
+        nl = buf.find('\n');
+        string line = buf.substr(0, nl);
+        buf.erase(0, nl + 1);
+        line_no++;
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+        ServeJob job;
+        string err;
+        bool ok = parse_job(line, job, err);
+        if (job.id.empty()) job.id = to_string(line_no);
+        if (!ok) {
+            client->send("ERR " + job.id + " " + err + "\n");
+            continue;
+        }
+        pool.submit([client, job, &cache] {
+            string report, err;
+            if (run_job(job, cache, report, err))
+                client->send("OK " + job.id + " " + to_string(report.size()) + "\n" + report);
+            else
+                client->send("ERR " + job.id + " " + err + "\n");
+        });
+    }
+}
+
+// Serves jobs from stdin until it ends ("-"), or on the Unix domain socket
+// at `where` until the process is stopped. Returns the exit status.
+inline int serve(const string& where, unsigned threads, size_t cache_bytes) {
+    signal(SIGPIPE, SIG_IGN);  // a client that disconnects early is not fatal
+    ThreadPool pool(threads);
+    TraceCache cache(cache_bytes);
+    if (where == "-") {
+        serve_client(make_shared<ServeClient>(0, 1, false), pool, cache);
+        pool.wait();
+        return 0;
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (where.size() >= sizeof(addr.sun_path)) {
+        cerr << "Socket path too long: " << where << "\n";
+        return 1;
+    }
+    strcpy(addr.sun_path, where.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        cerr << "Cannot listen on " << where << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    // Replace a socket left by an earlier server, but nothing else.
+    struct stat sb;
+    if (lstat(where.c_str(), &sb) == 0) {
+        if (!S_ISSOCK(sb.st_mode)) {
+            cerr << "Cannot listen on " << where << " (file exists)\n";
+            close(fd);
+            return 1;
+        }
+        unlink(where.c_str());
+    }
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        cerr << "Cannot listen on " << where << ": " << strerror(errno) << "\n";
+        close(fd);
+        return 1;
+    }
+    for (;;) {
+        int c = accept(fd, nullptr, nullptr);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            cerr << "Cannot accept on " << where << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+        thread(serve_client, make_shared<ServeClient>(c, c, true), ref(pool), ref(cache)).detach();
+    }
+}
+
+#endif
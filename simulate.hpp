@@ -0,0 +1,1355 @@
+#ifndef SIMULATE_HPP
+#define SIMULATE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cache.hpp"
+#include "bus.hpp"
+#include "trace.hpp"
+#include "events.hpp"
+#include "snoop.hpp"
+#include "pool.hpp"
+#include "instrument.hpp"
+#include "series.hpp"
+#include "checkpoint.hpp"
+#include "sampling.hpp"
+#include "hotspot.hpp"
+
+using namespace std;
+
+struct Stats {
+    unsigned long long instr = 0, reads = 0, writes = 0;
+    unsigned long long execution_cycles = 0, idle = 0;
+    unsigned long long misses = 0, evictions = 0, writebacks = 0;
+    unsigned long long invalidations = 0, traffic = 0;
+    unsigned long long bus_transactions = 0;
+    bool waiting_for_own_request = false;
+};
+
+template <class IO>
+void serialize(IO& io, Stats& st) {
+    io(st.instr);
+    io(st.reads);
+    io(st.writes);
+    io(st.execution_cycles);
+    io(st.idle);
+    io(st.misses);
+    io(st.evictions);
+    io(st.writebacks);
+    io(st.invalidations);
+    io(st.traffic);
+    io(st.bus_transactions);
+    io(st.waiting_for_own_request);
+}
+
+// Function to format address for debug output
+inline string format_addr(unsigned int addr, int s, int b) {
+    stringstream ss;
+    ss << "0x" << hex << addr << " (tag:0x" << (addr >> (s + b))
+       << ", set:" << dec << ((addr >> b) & ((1u << s) - 1))
+       << ", offset:" << (addr & ((1u << b) - 1)) << ")";
+    return ss.str();
+}
+
+// Quotes `text` as a JSON string literal.
+inline string json_string(const string& text) {
+    string out = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        out += ch;
+    }
+    return out + "\"";
+}
+
+// Stops the loop at a chosen cycle and hands its state out (see
+// simulator.hpp). pause() is called at the top of cycle `stop`, before it
+// runs, when there is still work left; it returns false to end the run
+// there.
+struct SimControl {
+    unsigned long long stop = UINT64_MAX;
+    virtual bool pause(unsigned long long cycle, const vector<Stats>& st) = 0;
+    virtual ~SimControl() {}
+};
+
+struct SimConfig {
+    int s = 5, E = 2, b = 5;
+    int cores = 4;
+    bool event_skip = true;
+    bool snoop_filter = false, check_snoop = false;
+    TagMatch tag_match = best_tag_match();
+    bool batch = true;       // retire runs of private hits in windows; --no-batch to not
+    bool parallel = false;   // play the windows on `threads` threads
+    unsigned threads = 1;
+    Replacement replacement = REPL_LRU;
+    bool generic = false;   // skip the kernels specialised for the geometry
+    bool timers = false;    // time the loop phases (see instrument.hpp)
+    unsigned long long interval = 0;   // --interval; 0 for none
+    SeriesWriter* series = nullptr;    // where the intervals go, if anywhere
+    string checkpoint;                 // write a checkpoint here...
+    unsigned long long checkpoint_at = 0;
+    bool checkpoint_refs = false;      // ...once checkpoint_at references (not cycles) are done
+    string restore;                    // start from this checkpoint
+    // --sample: period, measured and warm-up cycles (sampling.hpp)
+    unsigned long long sample_period = 0, sample_size = 10000, sample_warmup = 2000;
+    unsigned hotspots = 0;   // --hotspots: blocks and sets to list; 0 to not track them
+    int buses = 1;           // --buses: address-interleaved snooping buses (bus.hpp)
+    Arbitration arbitration = ARB_FIXED;
+    SimControl* control = nullptr;
+};
+
+// Limits of the simulation itself, which every way of starting a run
+// checks; option parsing checks the rest.
+inline bool check_config(const SimConfig& cfg, string& err) {
+    if (cfg.snoop_filter && cfg.cores > 64) {
+        err = "--snoop-filter supports at most 64 cores";  // sharer masks are 64 bits
+        return false;
+    }
+    return true;
+}
+
+struct SimResult {
+    vector<Stats> st;
+    unsigned long long cycles = 0;
+    double seconds = 0;
+    size_t cache_bytes = 0;
+    Profile profile;
+    // With an interval: bus busy cycles in all, and the most in one interval.
+    // series_from is where the intervals began (0 unless restored).
+    unsigned long long bus_busy = 0, peak_busy = 0, peak_start = 0, series_from = 0;
+    string error;   // why the run could not be done, if it could not
+    vector<SampledCore> sampled;   // with --sample; st and cycles are then estimates
+    HotspotTable hotspots;         // with --hotspots
+    vector<Bus> buses;             // each bus's transactions and busy cycles
+};
+
+// What a write hit does to the line: become M at once, take the bus to
+// invalidate the other copies first, or nothing.
+enum WriteHit { WRITE_TO_M, WRITE_UPGRADE, WRITE_NO_CHANGE };
+
+// Runs the MESI simulation until every core has drained its trace in refq,
+// with the replacement policy fixed at compile time. Non-zero SB, EA and BB
+// fix the set bits, associativity and block bits as well (they must match
+// cfg); kernels.hpp instantiates the common geometries.
+template <class Policy, int SB = 0, int EA = 0, int BB = 0>
+SimResult simulate_with(const SimConfig& cfg, vector<TraceFile>& refq) {
+    typedef Cache<Policy, EA> CacheT;
+    const int s = SB ? SB : cfg.s, E = EA ? EA : cfg.E, b = BB ? BB : cfg.b;
+    const int cores = cfg.cores;
+    const bool event_skip = cfg.event_skip;
+    const bool snoop_filter = cfg.snoop_filter, check_snoop = cfg.check_snoop;
+    const TagMatch tag_match = cfg.tag_match;
+
+    vector<CacheT> cache(cores, CacheT(s, E, b, tag_match));
+    Interconnect ic(cfg.buses, cfg.arbitration, cores);
+    vector<int> issue_order;
+    vector<Stats> st(cores);
+    vector<unsigned long long> stall_until(cores, 0);
+    unsigned long long global_cycle = 0;
+    PendingQueue pending_allocations;
+    PlannedChangeQueue planned_changes(cores, 1 << s);
+    vector<StallRequest> stall_requests;
+    // Scratch buffers reused by every miss so the loop does not allocate.
+    vector<pair<int, int>> other_copies;
+    vector<int> planned_copies;
+    // The core whose miss most recently took the bus; only it counts its
+    // stall cycles as execution rather than idle time.
+    int last_requester = -1;
+    Profile prof;
+    PROFILE(prof.init(cores, cfg.timers));
+    unique_ptr<IntervalSeries<Stats>> series;
+    if (cfg.interval)
+        series.reset(new IntervalSeries<Stats>(cfg.interval, cores, int(ic.buses.size()), cfg.series));
+    unique_ptr<HotspotTable> hot;
+    if (cfg.hotspots) hot.reset(new HotspotTable);
+
+    auto get_set = [&](unsigned int addr) { return (addr >> b) & ((1u << s) - 1); };
+    auto get_tag = [&](unsigned int addr) { return addr >> (s + b); };
+    auto block_words = (1u << b) / 4u;
+    auto block_of = [&](unsigned int tag, unsigned int set) { return (tag << s) | set; };
+    auto bus_of = [&](unsigned int addr) -> Bus& { return ic.bus(addr >> b); };
+    // The write hit's tests, in the issue loop's order, for every path that
+    // retires hits. E here is the associativity, which shadows State::E: with
+    // -E 1 a write to an S line becomes M without the bus, and with -E 4 or
+    // more a write to an E line changes nothing. Reports depend on both.
+    auto write_hit = [&](int state) {
+        if (state == M || state == E) return WRITE_TO_M;
+        if (state == S) return WRITE_UPGRADE;
+        return WRITE_NO_CHANGE;
+    };
+
+    // The snoop filter tracks every valid, non-I line, so each change to a
+    // line is bracketed by filter_out (old contents) and filter_in (new).
+    SnoopFilter filter(cores);
+    auto filter_out = [&](int core, unsigned int set, int way) {
+        const CacheT& C = cache[core];
+        if (snoop_filter && C.valid(set, way) && C.state(set, way) != I)
+            filter.remove(block_of(C.tag(set, way), set), core);
+    };
+    auto filter_in = [&](int core, unsigned int set, int way) {
+        const CacheT& C = cache[core];
+        if (snoop_filter && C.valid(set, way) && C.state(set, way) != I)
+            filter.add(block_of(C.tag(set, way), set), core, way);
+    };
+
+    // Other cores holding (tag, set) in a valid, non-I line, in core order.
+    vector<pair<int, int>> holders, probed_holders;
+    auto probe_all = [&](int c, unsigned int set, unsigned int tag, vector<pair<int, int>>& out) {
+        out.clear();
+        for (int o = 0; o < cores; o++) {
+            if (o == c) continue;
+            int oi = cache[o].find_line(tag, set);
+            if (oi >= 0 && cache[o].state(set, oi) != I) out.push_back({o, oi});
+        }
+    };
+    auto snoop = [&](int c, unsigned int set, unsigned int tag) -> const vector<pair<int, int>>& {
+        PROFILE_PHASE(prof, PHASE_SNOOP);
+        if (!snoop_filter) {
+            probe_all(c, set, tag, holders);
+            return holders;
+        }
+        holders.clear();
+        unsigned int block = block_of(tag, set);
+        uint64_t sharers = filter.sharers(block) & ~(uint64_t(1) << c);
+        for (; sharers; sharers &= sharers - 1) {
+            int o = __builtin_ctzll(sharers);
+            holders.push_back({o, filter.way(block, o)});
+        }
+        if (check_snoop) {
+            probe_all(c, set, tag, probed_holders);
+            if (probed_holders != holders) {
+                cerr << "Snoop filter mismatch at cycle " << global_cycle << " for "
+                     << format_addr((tag << (s + b)) | (set << b), s, b) << "\n";
+                exit(1);
+            }
+        }
+        return holders;
+    };
+
+    // Batched hits. Cores only see each other through the bus, so until the
+    // next cycle in which some core could start a bus transaction (the
+    // window's horizon) each core's hits, and the stalls of cores waiting for
+    // the busy bus, are private to it. scan() finds the horizon, advance()
+    // retires one core's references up to it at once, straight into its
+    // cache and Stats rather than through a PlannedChange each; with
+    // --parallel both run a thread per core when the window is long enough.
+    // The horizon cycle itself goes through the loop below, so the result is
+    // identical to playing every cycle there.
+    struct CoreWindow {
+        bool fill_pending = false, fill_due = false, filled = false;
+        PendingAllocation fill;   // this core's in-flight fill, if any
+        Line evicted;             // what the fill replaced, for the snoop filter
+        bool have_change = false;
+        PlannedChange change;     // hit planned in the last cycle played
+        bool ends = false;        // the whole rest of the trace hits
+        unsigned long long last_issue = 0;
+    };
+    const unsigned long long MIN_WINDOW = 16, PAR_WINDOW = 256, MAX_BACKOFF = 4096;
+    vector<CoreWindow> win(cfg.batch || cfg.parallel ? cores : 0);
+    unique_ptr<ThreadPool> pool;
+    if (cfg.parallel && cfg.threads > 1 && cores > 1)
+        pool.reset(new ThreadPool(min<unsigned>(cfg.threads, cores)));
+    atomic<unsigned long long> horizon(UINT64_MAX);
+    unsigned long long window_retry = 0;
+    // A window that retires only a few references costs more than playing
+    // its cycles in the loop, as in a run where every core soon misses again.
+    // After one the next try waits this many cycles, doubling while windows
+    // stay that short.
+    unsigned long long window_backoff = 0;
+
+    auto lower_horizon = [&](unsigned long long t) {
+        unsigned long long cur = horizon.load(memory_order_relaxed);
+        while (t < cur && !horizon.compare_exchange_weak(cur, t, memory_order_relaxed)) {
+        }
+    };
+    // Whether a reference of `type` to a line held in `state` completes
+    // without the bus.
+    auto private_hit = [&](char type, State state) {
+        return type != 'W' || write_hit(state) != WRITE_UPGRADE;
+    };
+    // Whether core c can complete R without the bus, counting its in-flight
+    // fill as installed: the core cannot issue before the fill lands.
+    auto local_hit = [&](int c, const Ref& R) {
+        const CoreWindow& w = win[c];
+        unsigned int set = get_set(R.addr), tag = get_tag(R.addr);
+        bool fill_set = w.fill_pending && set == unsigned(w.fill.set);
+        State state;
+        if (fill_set && tag == unsigned(w.fill.tag)) {
+            state = w.fill.state;
+        } else {
+            int idx = cache[c].find_line(tag, set);
+            if (idx < 0 || (fill_set && idx == w.fill.victim)) return false;
+            state = cache[c].state(set, idx);
+        }
+        return private_hit(R.type, state);
+    };
+    // Lowers the horizon to the first cycle from G in which core c would
+    // start a bus transaction. A reference needing the bus while it is busy
+    // only stalls the core until it frees, so that is where it would start.
+    auto scan = [&](int c, unsigned long long G) {
+        CoreWindow& w = win[c];
+        w.ends = false;
+        if (refq[c].empty()) return;
+        const Ref* r = refq[c].begin();
+        size_t n = refq[c].size();
+        unsigned long long t = max(G, stall_until[c]);
+        for (size_t i = 0; i < n; i++, t++) {
+            if (t >= horizon.load(memory_order_relaxed)) return;
+            if (!local_hit(c, r[i])) {
+                lower_horizon(max(t, bus_of(r[i].addr).busy_until));
+                return;
+            }
+        }
+        if (refq[c].streamed()) {
+            lower_horizon(t);
+        } else {
+            w.ends = true;
+            w.last_issue = t - 1;
+        }
+    };
+    // Plays cycles [G, H) for core c exactly as the loop below would.
+    auto advance = [&](int c, unsigned long long G, unsigned long long H) {
+        CoreWindow& w = win[c];
+        CacheT& C = cache[c];
+        Stats& sc = st[c];
+        w.have_change = false;
+        unsigned long long t = G;
+        while (t < H) {
+            if (w.have_change) {
+                C.set_line(w.change.set, w.change.idx, true, w.change.state, w.change.tag,
+                           w.change.last_used);
+                w.have_change = false;
+            }
+            if (w.fill_due && w.fill.complete_cycle == t) {
+                w.evicted = C.line(w.fill.set, w.fill.victim);
+                C.fill(w.fill.set, w.fill.victim, w.fill.tag, w.fill.state);
+                w.fill_due = false;
+                w.filled = true;
+            }
+            if (refq[c].empty()) break;
+            if (t < stall_until[c]) {
+                unsigned long long next = min(stall_until[c], H);
+                if (w.fill_due) next = min(next, w.fill.complete_cycle);
+                if (!sc.waiting_for_own_request) {
+                    sc.idle += next - t;
+                } else {
+                    sc.execution_cycles += next - t;
+                }
+                t = next;
+                continue;
+            }
+
+            sc.execution_cycles++;
+            Ref R = refq[c].front();
+            unsigned int set = get_set(R.addr), tag = get_tag(R.addr);
+            bool isWrite = (R.type == 'W');
+            int idx = C.find_line(tag, set);
+            State now = idx >= 0 ? C.state(set, idx) : I;
+            WriteHit wh = isWrite ? write_hit(now) : WRITE_TO_M;
+            bool planned = !isWrite || wh == WRITE_TO_M;
+            if (idx < 0 || wh == WRITE_UPGRADE) {
+                // Before the horizon this only happens while the bus is busy.
+                const Bus& bus = bus_of(R.addr);
+                assert(t < bus.busy_until);
+                PROFILE(prof.bus_denied(c, t));
+                ic.refused(c, t);
+                stall_until[c] = bus.busy_until;
+                t++;
+                continue;
+            }
+            if (planned) {
+                w.change = {c, set, idx, true, isWrite ? M : now, tag,
+                            C.access_stamp(), t + 1, STATE_TRANSITION};
+                w.have_change = true;
+            }
+            refq[c].pop_front();
+            sc.instr++;
+            if (isWrite)
+                sc.writes++;
+            else
+                sc.reads++;
+            t++;
+        }
+    };
+    // Runs f for every core, split across the pool if `spread`.
+    auto for_cores = [&](const function<void(int)>& f, bool spread) {
+        if (!pool || !spread) {
+            for (int c = 0; c < cores; c++) f(c);
+            return;
+        }
+        unsigned n = pool->size();
+        for (unsigned k = 0; k < n; k++)
+            pool->submit([&, k] {
+                for (int c = k; c < cores; c += n) f(c);
+            });
+        pool->wait();
+    };
+
+    // Everything the loop carries from one cycle to the next, for
+    // checkpoints. A core's trace position is its instruction count.
+    auto transfer = [&](auto& io) {
+        io(global_cycle);
+        ic.serialize(io);
+        io(last_requester);
+        for (int c = 0; c < cores; c++) {
+            serialize(io, st[c]);
+            io(stall_until[c]);
+            cache[c].serialize(io);
+        }
+        pending_allocations.serialize(io);
+        planned_changes.serialize(io);
+        // Stall requests only live within a cycle; the count is always 0.
+        uint64_t requests = stall_requests.size();
+        io(requests);
+        return requests == 0;
+    };
+    auto failed = [](const string& why) {
+        SimResult r;
+        r.error = why;
+        return r;
+    };
+    if (!cfg.restore.empty()) {
+        CheckpointReader in;
+        CheckpointHeader h;
+        string err;
+        if (!in.open(cfg.restore, h, err)) return failed(err);
+        if (int(h.cores) != cores || h.s != s || h.E != E || h.b != b ||
+            h.replacement != uint32_t(Policy::kind) || h.buses != ic.buses.size() ||
+            h.arbitration != uint32_t(cfg.arbitration))
+            return failed("Checkpoint " + cfg.restore + " is for another configuration");
+        bool none_pending = transfer(in);
+        if (!in.finish(err)) return failed(err);
+        if (!none_pending) return failed("Checkpoint " + cfg.restore + " is corrupt");
+        for (int c = 0; c < cores; c++)
+            if (refq[c].skip(st[c].instr) != st[c].instr)
+                return failed("Trace of core " + to_string(c) + " is shorter than checkpoint " +
+                              cfg.restore + " expects");
+        for (int c = 0; c < cores; c++)
+            for (int set = 0; set < (1 << s); set++)
+                for (int way = 0; way < E; way++) filter_in(c, set, way);
+        if (series) {
+            vector<unsigned long long> busy_until;
+            for (const Bus& bus : ic.buses) busy_until.push_back(bus.busy_until);
+            series->resume(global_cycle, st, busy_until);
+        }
+    }
+
+    // Sampling state (sampling.hpp). Windows are counted in cycles from
+    // window_start; `draining` stops every core from issuing between the end
+    // of a measurement and the functional phase.
+    const bool sampling = cfg.sample_period > 0;
+    const unsigned long long skip_cycles =
+        cfg.sample_period - cfg.sample_warmup - cfg.sample_size;
+    bool measuring = false, draining = false;
+    unsigned long long window_start = 0;
+    vector<Stats> mark(cores);
+    vector<vector<Sample>> samples(cores);
+    vector<SampledCore> sampled(cores);
+    vector<unsigned long long> functional_reads(cores, 0);
+    // What the functional phases stand for, extrapolated from each core's
+    // previous window.
+    vector<double> skipped_exec(cores, 0), skipped_cycles(cores, 0);
+    vector<Sample> skipped(cores);
+    vector<pair<int, int>> sharers;
+    auto issuing = [&](int c) { return !(sampling && draining) && !refq[c].empty(); };
+    // Applies R to the caches at once, with no timing, making the same
+    // state changes as the issue loop below: a miss takes the block from the
+    // other caches as the bus would, a write to a shared line invalidates
+    // every other copy.
+    auto functional = [&](int c, const Ref& R) {
+        unsigned int set = get_set(R.addr), tag = get_tag(R.addr);
+        bool isWrite = R.type == 'W';
+        CacheT& C = cache[c];
+        int idx = C.find_line(tag, set);
+        if (idx >= 0 && C.state(set, idx) != I) {
+            WriteHit wh = isWrite ? write_hit(C.state(set, idx)) : WRITE_TO_M;
+            if (wh == WRITE_NO_CHANGE) return;  // as in the loop, which plans no change here
+            if (wh == WRITE_UPGRADE) {
+                for (const auto& h : snoop(c, set, tag)) {
+                    filter_out(h.first, set, h.second);
+                    cache[h.first].set_state(set, h.second, I);
+                    filter_in(h.first, set, h.second);
+                }
+            }
+            filter_out(c, set, idx);
+            C.set_line(set, idx, true, isWrite ? M : C.state(set, idx), tag, C.access_stamp());
+            filter_in(c, set, idx);
+            return;
+        }
+        sharers = snoop(c, set, tag);
+        for (const auto& h : sharers) {
+            filter_out(h.first, set, h.second);
+            cache[h.first].set_state(set, h.second, isWrite ? I : S);
+            filter_in(h.first, set, h.second);
+        }
+        int v = C.choose_victim(set);
+        filter_out(c, set, v);
+        C.fill(set, v, tag, isWrite ? M : sharers.empty() ? State::E : S);
+        filter_in(c, set, v);
+    };
+    // Starts and ends the measurement of the current window.
+    auto track_window = [&]() {
+        if (draining) return;
+        if (!measuring && global_cycle >= window_start + cfg.sample_warmup) {
+            mark = st;
+            measuring = true;
+        }
+        if (measuring && global_cycle >= window_start + cfg.sample_warmup + cfg.sample_size) {
+            for (int c = 0; c < cores; c++) {
+                const Stats &a = st[c], &m = mark[c];
+                Sample x;
+                x.refs = a.instr - m.instr;
+                x.exec = a.execution_cycles - m.execution_cycles;
+                x.cycles = x.exec + a.idle - m.idle;
+                x.misses = a.misses - m.misses;
+                x.evictions = a.evictions - m.evictions;
+                x.writebacks = a.writebacks - m.writebacks;
+                x.invalidations = a.invalidations - m.invalidations;
+                x.traffic = a.traffic - m.traffic;
+                x.bus_transactions = a.bus_transactions - m.bus_transactions;
+                if (x.cycles) samples[c].push_back(x);
+            }
+            measuring = false;
+            draining = true;
+        }
+    };
+    // Once the bus is quiet after a measurement: stands in for the next
+    // skip_cycles cycles by running each core functionally at the rate it
+    // completed references in the measurement, interleaving the cores, and
+    // opens the next window. Returns false if no references are left.
+    auto functional_phase = [&]() {
+        vector<double> rate(cores, 0);
+        vector<unsigned long long> done(cores, 0);
+        for (int c = 0; c < cores; c++)
+            if (!samples[c].empty())
+                rate[c] = double(samples[c].back().refs) / samples[c].back().cycles;
+        // Each step applies the reference due first, so the cores interleave
+        // as they would in time.
+        for (;;) {
+            int next = -1;
+            double first = 0;
+            for (int c = 0; c < cores; c++) {
+                if (rate[c] == 0 || refq[c].empty()) continue;
+                double t = (done[c] + 1) / rate[c];
+                if (t <= skip_cycles && (next < 0 || t < first)) {
+                    next = c;
+                    first = t;
+                }
+            }
+            if (next < 0) break;
+            const Ref& R = refq[next].front();
+            functional_reads[next] += R.type != 'W';
+            functional(next, R);
+            refq[next].pop_front();
+            done[next]++;
+        }
+        bool left = false;
+        for (int c = 0; c < cores; c++) {
+            if (samples[c].empty() || (done[c] == 0 && refq[c].empty())) continue;
+            // The core ran for skip_cycles, or until its trace ran out.
+            const Sample& x = samples[c].back();
+            double active = refq[c].empty() && rate[c] > 0 ? done[c] / rate[c] : skip_cycles;
+            skipped_cycles[c] += active;
+            skipped_exec[c] += active * x.exec / x.cycles;
+            skipped[c].refs += done[c];
+            if (x.refs) {
+                double per_ref = double(done[c]) / x.refs;
+                skipped[c].misses += llround(x.misses * per_ref);
+                skipped[c].evictions += llround(x.evictions * per_ref);
+                skipped[c].writebacks += llround(x.writebacks * per_ref);
+                skipped[c].invalidations += llround(x.invalidations * per_ref);
+                skipped[c].traffic += llround(x.traffic * per_ref);
+                skipped[c].bus_transactions += llround(x.bus_transactions * per_ref);
+            }
+            left |= !refq[c].empty();
+        }
+        for (int c = 0; c < cores; c++) left |= !refq[c].empty();
+        // Whatever a core was waiting for the bus for has been applied.
+        fill(ic.waiting_since.begin(), ic.waiting_since.end(), Interconnect::NOT_WAITING);
+        window_start = global_cycle;
+        draining = false;
+        return left;
+    };
+
+    string error;
+    bool checkpoint_pending = !cfg.checkpoint.empty();
+    // Cycles the loop must stop at rather than skip or run a window across.
+    auto next_stop = [&]() {
+        unsigned long long stop = series ? series->next : UINT64_MAX;
+        if (cfg.control) stop = min(stop, cfg.control->stop);
+        if (checkpoint_pending && !cfg.checkpoint_refs) stop = min(stop, cfg.checkpoint_at);
+        if (sampling && !draining)
+            stop = min(stop, window_start + cfg.sample_warmup + (measuring ? cfg.sample_size : 0));
+        return stop;
+    };
+    auto refs_done = [&]() {
+        unsigned long long n = 0;
+        for (int c = 0; c < cores; c++) n += st[c].instr;
+        return n;
+    };
+
+    auto start_time = chrono::high_resolution_clock::now();
+    while (true) {
+        if (series && global_cycle == series->next) series->close(global_cycle, st);
+
+        if (sampling) track_window();
+
+        if (checkpoint_pending &&
+            (cfg.checkpoint_refs ? refs_done() : global_cycle) >= cfg.checkpoint_at) {
+            checkpoint_pending = false;
+            CheckpointWriter out;
+            CheckpointHeader h = {};
+            h.cores = cores;
+            h.s = s;
+            h.E = E;
+            h.b = b;
+            h.replacement = Policy::kind;
+            h.buses = ic.buses.size();
+            h.arbitration = cfg.arbitration;
+            h.cycle = global_cycle;
+            h.refs = refs_done();
+            if (out.open(cfg.checkpoint, h, error)) {
+                transfer(out);
+                out.finish(error);
+            }
+        }
+
+        bool done = true;
+        for (int c = 0; c < cores; c++) {
+            if (issuing(c) || global_cycle < stall_until[c]) {
+                done = false;
+                break;
+            }
+        }
+        if (done && pending_allocations.empty() && planned_changes.empty()) {
+            if (sampling && draining && functional_phase()) continue;
+            break;
+        }
+        if (cfg.control && global_cycle >= cfg.control->stop && !cfg.control->pause(global_cycle, st))
+            break;
+
+        // Jump straight to the next cycle in which something can happen: a core
+        // becomes free to issue, a fill completes or a planned change applies.
+        // Every cycle skipped is one in which each core with work left is stalled,
+        // so it only adds to that core's idle or execution count.
+        if (event_skip) {
+            unsigned long long next_event = UINT64_MAX;
+            for (int c = 0; c < cores; c++) {
+                if (global_cycle < stall_until[c])
+                    next_event = min(next_event, stall_until[c]);
+                else if (issuing(c))
+                    next_event = global_cycle;
+            }
+            next_event = min(next_event, pending_allocations.next_cycle());
+            next_event = min(next_event, planned_changes.next_cycle(global_cycle));
+            if (next_event != UINT64_MAX) next_event = min(next_event, next_stop());
+            if (next_event != UINT64_MAX && next_event > global_cycle) {
+                unsigned long long skipped = next_event - global_cycle;
+                for (int c = 0; c < cores; c++) {
+                    if (!issuing(c)) continue;
+                    if (!st[c].waiting_for_own_request) {
+                        st[c].idle += skipped;
+                    } else {
+                        st[c].execution_cycles += skipped;
+                    }
+                }
+                global_cycle = next_event;
+                continue;
+            }
+        }
+
+        {
+            PROFILE_PHASE(prof, PHASE_APPLY);
+            planned_changes.apply_due(global_cycle, [&](const PlannedChange& pc) {
+                CacheT& C = cache[pc.core];
+                filter_out(pc.core, pc.set, pc.idx);
+                if (pc.type == STATE_TRANSITION) {
+                    C.set_line(pc.set, pc.idx, pc.valid, pc.state, pc.tag, pc.last_used);
+                } else {
+                    // Invalidations only change the state; the line keeps its
+                    // valid bit, tag and LRU stamp.
+                    C.set_state(pc.set, pc.idx, pc.state);
+                }
+                filter_in(pc.core, pc.set, pc.idx);
+            });
+        }
+
+        {
+            PROFILE_PHASE(prof, PHASE_DRAIN);
+            pending_allocations.drain(global_cycle, [&](const PendingAllocation& pa) {
+                CacheT& C = cache[pa.core];
+                filter_out(pa.core, pa.set, pa.victim);
+                C.fill(pa.set, pa.victim, pa.tag, pa.state);
+                filter_in(pa.core, pa.set, pa.victim);
+            });
+        }
+
+        if (!win.empty() && !sampling && global_cycle >= window_retry && planned_changes.empty()) {
+            PROFILE_PHASE(prof, PHASE_WINDOW);
+            const unsigned long long G = global_cycle;
+            // Most tries in a bus-bound run end at once: a core free to issue
+            // needs the bus. Such a core has no fill in flight (it stalls at
+            // least until its fill lands), so its cache alone tells. With
+            // no core free, the event skip gets past the stalls for less.
+            horizon = UINT64_MAX;
+            bool any_free = false;
+            for (int c = 0; c < cores && horizon >= G + MIN_WINDOW; c++) {
+                if (refq[c].empty() || stall_until[c] > G) continue;
+                any_free = true;
+                const Ref& R = refq[c].front();
+                unsigned int set = get_set(R.addr);
+                int idx = cache[c].find_line(get_tag(R.addr), set);
+                if (idx < 0 || !private_hit(R.type, cache[c].state(set, idx)))
+                    lower_horizon(max(G, bus_of(R.addr).busy_until));
+            }
+            if (!any_free && event_skip) horizon = G;
+            if (horizon >= G + MIN_WINDOW) {
+                for (CoreWindow& w : win) w.fill_pending = w.fill_due = w.filled = false;
+                pending_allocations.for_each([&](const PendingAllocation& pa) {
+                    assert(!win[pa.core].fill_pending);
+                    win[pa.core].fill_pending = true;
+                    win[pa.core].fill = pa;
+                });
+                // Cheap first bound from each core's next reference.
+                for (int c = 0; c < cores; c++)
+                    if (!refq[c].empty() && !local_hit(c, refq[c].front()))
+                        lower_horizon(max(max(G, stall_until[c]), bus_of(refq[c].front().addr).busy_until));
+            }
+            if (horizon >= G + MIN_WINDOW) {
+                for_cores([&](int c) { scan(c, G); }, horizon - G >= PAR_WINDOW);
+                if (horizon == UINT64_MAX) {
+                    // No core needs the bus again: stop at the last reference
+                    // and let the loop wind down.
+                    horizon = G;
+                    for (const CoreWindow& w : win)
+                        if (w.ends) horizon = max<unsigned long long>(horizon, w.last_issue);
+                }
+            }
+            unsigned long long H = horizon;
+            window_retry = H + 1;
+            if (H > next_stop()) {
+                // Stop at the interval boundary or checkpoint and carry on
+                // from there.
+                H = next_stop();
+                window_retry = H;
+            }
+            if (H >= G + MIN_WINDOW) {
+                pending_allocations.drain(H - 1, [&](const PendingAllocation& pa) {
+                    win[pa.core].fill_due = true;
+                });
+                unsigned long long retired = refs_done();
+                for_cores([&](int c) { advance(c, G, H); }, H - G >= PAR_WINDOW);
+                retired = refs_done() - retired;
+                if (retired >= MIN_WINDOW) {
+                    window_backoff = 0;
+                } else {
+                    window_backoff = min(max(2 * window_backoff, MIN_WINDOW), MAX_BACKOFF);
+                    window_retry = H + window_backoff;
+                }
+                for (int c = 0; c < cores; c++) {
+                    const CoreWindow& w = win[c];
+                    if (w.filled && snoop_filter) {
+                        if (w.evicted.valid && w.evicted.state != I)
+                            filter.remove(block_of(w.evicted.tag, w.fill.set), c);
+                        filter_in(c, w.fill.set, w.fill.victim);
+                    }
+                    if (w.have_change) planned_changes.push(w.change, H - 1);
+                }
+                global_cycle = H;
+                continue;
+            }
+        }
+
+        PROFILE(prof.calls[PHASE_ISSUE]++);
+        PROFILE(unsigned long long issue_start = prof.timing ? Profile::now() : 0);
+        const bool arbitrate = cfg.arbitration != ARB_FIXED;
+        if (arbitrate)
+            ic.issue_order(global_cycle, issue_order, [&](int c) {
+                return refq[c].empty() ? 0u : refq[c].front().addr >> b;
+            });
+        for (int k = 0; k < cores; k++) {
+            int c = arbitrate ? issue_order[k] : k;
+            if (!issuing(c)) continue;
+            if (global_cycle < stall_until[c]) {
+                if (!st[c].waiting_for_own_request) {
+                    st[c].idle++;
+                } else {
+                    st[c].execution_cycles++;
+                }
+                continue;
+            }
+
+            st[c].execution_cycles++;
+            
+            Ref R = refq[c].front();
+            unsigned int set = get_set(R.addr), tag = get_tag(R.addr);
+            bool isWrite = (R.type == 'W');
+            CacheT& C = cache[c];
+            int idx = C.find_line(tag, set);
+
+            if (idx >= 0 && C.state(set, idx) != I) {
+                if (isWrite) {
+                    WriteHit wh = write_hit(C.state(set, idx));
+                    if (wh == WRITE_TO_M) {
+                        planned_changes.push(
+                            {c, set, idx, true, M, tag, C.access_stamp(), global_cycle + 1, STATE_TRANSITION}, global_cycle);
+                    } else if (wh == WRITE_UPGRADE) {
+                        Bus& bus = bus_of(R.addr);
+                        if (bus.free_at(global_cycle)) {
+                            PROFILE(prof.bus_granted(c, global_cycle));
+                            st[c].bus_transactions++;
+                            ic.granted(bus, c);
+                            bus.occupy(global_cycle, 1);
+                            if (series) series->bus(&bus - ic.buses.data(), global_cycle, 1);
+                            int invalidated_others = 0;
+                            
+                            for (const auto& holder : snoop(c, set, tag)) {
+                                int o = holder.first;
+                                int oi = holder.second;
+                                planned_changes.push({o, set, oi, false, I, cache[o].tag(set, oi), 0, global_cycle + 1, INVALIDATION}, global_cycle);
+                                invalidated_others++;
+                            }
+                            if (invalidated_others) {
+                                st[c].invalidations++;
+                            }
+                            if (hot) {
+                                BlockHeat& h = hot->at(R.addr >> b);
+                                h.upgrades++;
+                                h.invalidations += invalidated_others;
+                                h.write(c, R.addr & ((1u << b) - 1));
+                            }
+                            
+                            planned_changes.push({c, set, idx, true, M, tag, C.access_stamp(), global_cycle + 1, STATE_TRANSITION}, global_cycle);
+                        } else {
+                            PROFILE(prof.bus_denied(c, global_cycle));
+                            ic.refused(c, global_cycle);
+                            stall_until[c] = bus.busy_until;
+                            continue;
+                        }
+                    }
+                } else { // Read hit
+                    planned_changes.push({c, set, idx, true,
+                                          C.state(set, idx), tag,
+                                          C.access_stamp(), global_cycle + 1, STATE_TRANSITION}, global_cycle);
+                }
+                refq[c].pop_front();
+                st[c].instr++;
+                if (isWrite)
+                    st[c].writes++;
+                else
+                    st[c].reads++;
+            } else { // Cache miss
+                Bus& bus = bus_of(R.addr);
+                if (!bus.free_at(global_cycle)) {
+                    PROFILE(prof.bus_denied(c, global_cycle));
+                    ic.refused(c, global_cycle);
+                    stall_until[c] = bus.busy_until;
+                    continue;
+                }
+                ic.granted(bus, c);
+                PROFILE(unsigned long long requested = prof.bus_granted(c, global_cycle));
+
+                if (last_requester >= 0) {
+                    st[last_requester].waiting_for_own_request = false;
+                }
+                st[c].waiting_for_own_request = true;
+                last_requester = c;
+                
+                st[c].misses++;
+                bool isRdX = isWrite;
+                bool found_shared = false, found_mod = false;
+
+                other_copies.clear();
+                
+                for (const auto& holder : snoop(c, set, tag)) {
+                    int o = holder.first;
+                    int oi = holder.second;
+                    found_shared = true;
+                    other_copies.push_back({o, oi});
+                    
+                    if (cache[o].state(set, oi) == M) {
+                        found_mod = true;
+                    }
+                }
+                
+                // Changes other cores planned earlier this cycle, in the order
+                // they were planned.
+                planned_copies.clear();
+                for (int o = 0; o < cores; o++) {
+                    if (o == c) continue;
+                    for (int h = planned_changes.first(o, set); h >= 0; h = planned_changes.next(h)) {
+                        const PlannedChange& pc = planned_changes.at(h);
+                        if (pc.apply_cycle > global_cycle && pc.tag == tag && pc.valid && pc.state != I)
+                            planned_copies.push_back(h);
+                    }
+                }
+                sort(planned_copies.begin(), planned_copies.end(), [&](int x, int y) {
+                    return planned_changes.seq(x) < planned_changes.seq(y);
+                });
+                for (int h : planned_copies) {
+                    const PlannedChange& pc = planned_changes.at(h);
+                    found_shared = true;
+                    
+                    bool already_counted = false;
+                    for (const auto& other : other_copies) {
+                        if (other.first == pc.core && other.second == pc.idx) {
+                            already_counted = true;
+                            break;
+                        }
+                    }
+                    
+                    if (!already_counted) {
+                        other_copies.push_back({pc.core, pc.idx});
+                    }
+                    
+                    if (pc.state == M) {
+                        found_mod = true;
+                    }
+                }
+
+                State new_state;
+                unsigned long long data_transfer_cycles;
+                bool needs_invalidation = false;
+                
+                if (isRdX) { // Write miss
+                    new_state = State::M; 
+                    
+                    if (found_mod) {
+                        data_transfer_cycles = 200;
+                        
+                        for (const auto& other : other_copies) {
+                            int o = other.first;
+                            int oi = other.second;
+                            
+                            if (cache[o].state(set, oi) == M) {
+                                stall_requests.push_back({o, global_cycle + 101});
+                                st[o].traffic += (1u << b);
+                                if (hot) {
+                                    BlockHeat& h = hot->at(R.addr >> b);
+                                    h.transfers++;
+                                    h.wb_stalls++;
+                                    h.stall_cycles += 101;
+                                }
+                            }
+                            
+                            needs_invalidation = true;
+                        }
+                    } else {
+                        data_transfer_cycles = 101;
+                        st[c].traffic += (1u << b);
+                        
+                        if (!other_copies.empty()) {
+                            needs_invalidation = true;
+                        }
+                    }
+                } else { // Read miss
+                    if (found_shared) {
+                        new_state = S;
+                        data_transfer_cycles = 2 * block_words;
+                        bool data_transferred = false;
+                        for (const auto& other : other_copies) {
+                            int o = other.first;
+                            int oi = other.second;
+                            
+                            bool skip = false;
+                            for (int h = planned_changes.first(o, set); h >= 0; h = planned_changes.next(h)) {
+                                const PlannedChange& pc = planned_changes.at(h);
+                                if (pc.idx == oi && pc.state == I) {
+                                    skip = true;
+                                    break;
+                                }
+                            }
+                            
+                            if (skip) continue;
+                            
+                            if (!data_transferred && cache[o].state(set, oi) != I) {
+                                st[o].traffic += (1u << b);
+                                
+                                if (cache[o].state(set, oi) == M) {
+                                    st[o].traffic += (1u << b);
+                                    
+                                    stall_requests.push_back({o, global_cycle + 2 * block_words + 100});
+                                    if (hot) {
+                                        BlockHeat& h = hot->at(R.addr >> b);
+                                        h.wb_stalls++;
+                                        h.stall_cycles += 2 * block_words + 100;
+                                    }
+                                } else {
+                                    stall_requests.push_back({o, global_cycle + 2 * block_words});
+                                }
+                                
+                                data_transferred = true;
+                            }
+                            
+                            planned_changes.push(
+                                {o, set, oi, true, S,
+                                 cache[o].tag(set, oi),
+                                 cache[o].last_used(set, oi),
+                                 global_cycle + 1, STATE_TRANSITION}, global_cycle);
+                        }
+                        data_transfer_cycles = 2 * block_words;
+                    } else {
+                        new_state = State::E;
+                        data_transfer_cycles = 101;
+                        st[c].traffic += (1u << b);
+                    }
+                }
+
+                unsigned long long total_bus_cycles = data_transfer_cycles;
+                
+                if (needs_invalidation) {
+                    for (const auto& other : other_copies) {
+                        int o = other.first;
+                        int oi = other.second;
+                        planned_changes.push({o, set, oi, false, I, cache[o].tag(set, oi),  0, global_cycle + 1, INVALIDATION}, global_cycle);
+                    }
+                    st[c].invalidations++;
+                    if (hot) hot->at(R.addr >> b).invalidations += other_copies.size();
+                }
+                if (hot && isWrite && !other_copies.empty())
+                    hot->at(R.addr >> b).write(c, R.addr & ((1u << b) - 1));
+                
+                int v = C.choose_victim(set);
+                bool needs_writeback = false;
+                
+                if (C.valid(set, v)) {
+                    if (C.state(set, v) == M) {
+                        needs_writeback = true;
+                        st[c].writebacks++;
+                        st[c].traffic += (1u << b);
+                        total_bus_cycles += 100;
+                    }
+                    if (C.state(set, v) != I)
+                        st[c].evictions++;
+                }
+
+                unsigned long long allocation_completion_cycle = global_cycle + total_bus_cycles;
+                PendingAllocation pa;
+                pa.core = c;
+                pa.set = set;
+                pa.victim = v;
+                pa.tag = tag;
+                pa.state = new_state;
+                pa.complete_cycle = allocation_completion_cycle;
+                
+                pending_allocations.push(pa);
+                PROFILE(prof.miss_latency[c].add(allocation_completion_cycle - requested));
+                
+                bus.occupy(global_cycle, total_bus_cycles);
+                if (series) series->bus(&bus - ic.buses.data(), global_cycle, total_bus_cycles);
+                stall_until[c] = bus.busy_until;
+                st[c].bus_transactions++;
+            }
+        }
+
+        PROFILE(if (prof.timing) prof.ticks[PHASE_ISSUE] += Profile::now() - issue_start);
+
+        {
+            PROFILE_PHASE(prof, PHASE_STALL_MERGE);
+            for (const auto& req : stall_requests) {
+                if (global_cycle >= stall_until[req.core]) {
+                    stall_until[req.core] = req.until_cycle;
+                } else {
+                    stall_until[req.core] = max(stall_until[req.core], stall_until[req.core] + (req.until_cycle - global_cycle));
+                }
+            }
+            stall_requests.clear();
+        }
+
+        global_cycle++;
+    }
+
+    if (checkpoint_pending)
+        error = "The run ended before the checkpoint at " +
+                to_string(cfg.checkpoint_at) + (cfg.checkpoint_refs ? " references" : " cycles");
+
+    auto end_time = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end_time - start_time;
+
+    SimResult res;
+    if (series) {
+        if (global_cycle > series->row_start()) series->close(global_cycle, st);
+        res.bus_busy = series->busy;
+        res.peak_busy = series->peak;
+        res.peak_start = series->peak_start;
+        res.series_from = series->origin;
+    }
+    res.error = error;
+    res.st = st;
+    res.cycles = global_cycle;
+    if (sampling) {
+        // Add what the functional phases stand for to the detailed counts.
+        // Reads and writes are known exactly.
+        unsigned long long longest = 0, all_skipped = 0;
+        bool skipped_any = false;
+        for (int c = 0; c < cores; c++) all_skipped += skipped[c].refs;
+        for (int c = 0; c < cores; c++) {
+            SampledCore& sc = sampled[c];
+            Stats& out = res.st[c];
+            const Sample& k = skipped[c];
+            sc.samples = samples[c].size();
+            sc.detailed_refs = st[c].instr;
+            sc.refs = st[c].instr + k.refs;
+            skipped_any |= k.refs > 0 || skipped_cycles[c] > 0;
+            out.instr = sc.refs;
+            out.reads = st[c].reads + functional_reads[c];
+            out.writes = out.instr - out.reads;
+            out.execution_cycles += llround(skipped_exec[c]);
+            unsigned long long cycles = st[c].execution_cycles + st[c].idle + llround(skipped_cycles[c]);
+            out.idle = cycles - out.execution_cycles;
+            // Extrapolation can overshoot: a window counts the misses of
+            // references it has not completed yet, which the functional phase
+            // then completes. At most one miss, eviction and writeback per
+            // skipped reference, and one invalidation per skipped reference
+            // of another core; over the run, at most one miss per reference,
+            // eviction per miss and writeback per eviction.
+            out.misses = min(out.misses + min(k.misses, k.refs), out.instr);
+            out.evictions = min(out.evictions + min(k.evictions, k.refs), out.misses);
+            out.writebacks = min(out.writebacks + min(k.writebacks, k.refs), out.evictions);
+            out.invalidations += min(k.invalidations, all_skipped - k.refs);
+            out.traffic += k.traffic;
+            out.bus_transactions += k.bus_transactions;
+            // Only the skipped references are uncertain.
+            auto ci = [&](unsigned long long Sample::*field) {
+                return k.refs ? estimate(samples[c], field, k.refs).ci : 0.0;
+            };
+            sc.cycles = {double(cycles), ci(&Sample::cycles)};
+            sc.misses = {double(out.misses), ci(&Sample::misses)};
+            sc.traffic = {double(out.traffic), ci(&Sample::traffic)};
+            longest = max(longest, cycles);
+        }
+        // Without a functional phase every reference ran in detail.
+        if (skipped_any) res.cycles = longest;
+        res.sampled = sampled;
+    }
+    res.seconds = elapsed.count();
+    res.cache_bytes = cache[0].memory_bytes();
+    PROFILE(prof.finish());
+    res.profile = prof;
+    if (hot) res.hotspots = move(*hot);
+    res.buses = ic.buses;
+    return res;
+}
+
+// The confidence intervals behind a sampled run's report.
+inline void write_sampling_summary(ostream& out, const SimConfig& cfg,
+                                   const vector<SampledCore>& sampled) {
+    // Half-width relative to the estimate, or why there is none.
+    auto relative = [](const Estimate& e) {
+        stringstream ss;
+        if (std::isnan(e.ci))
+            ss << "unknown (fewer than 2 samples)";
+        else
+            ss << fixed << setprecision(2) << (e.total > 0 ? e.ci / e.total * 100.0 : 0.0) << "%";
+        return ss.str();
+    };
+    out << "\nSampling Summary (95% confidence):\n";
+    out << "Period / Warm-up / Sample (cycles): " << cfg.sample_period << " / "
+        << cfg.sample_warmup << " / " << cfg.sample_size << "\n";
+    for (size_t c = 0; c < sampled.size(); c++) {
+        const SampledCore& sc = sampled[c];
+        out << "Core " << c << ": " << sc.samples << " samples, " << sc.detailed_refs << " of "
+            << sc.refs << " references in detail\n";
+        out << "  Cycles: " << llround(sc.cycles.total) << " +/- " << relative(sc.cycles) << "\n";
+        out << "  Cache Miss Rate: " << fixed << setprecision(2)
+            << (sc.refs ? sc.misses.total / sc.refs * 100.0 : 0.0) << "% +/- ";
+        if (std::isnan(sc.misses.ci))
+            out << relative(sc.misses) << "\n";
+        else
+            out << (sc.refs ? sc.misses.ci / sc.refs * 100.0 : 0.0) << " points\n";
+        out << "  Data Traffic (Bytes): " << llround(sc.traffic.total) << " +/- "
+            << relative(sc.traffic) << "\n";
+    }
+}
+
+// The --hotspots section of the report: the blocks and sets with the most
+// coherence events, and the blocks that several cores wrote without ever
+// writing the same word (likely false sharing). A falsely shared block
+// lists each word written and its last writer.
+inline void write_hotspot_report(ostream& out, const SimConfig& cfg, const HotspotTable& hot) {
+    auto row = [&](const BlockHeat& h) {
+        out << setw(14) << h.invalidations << setw(10) << h.upgrades << setw(8) << h.transfers
+            << setw(11) << h.wb_stalls << setw(14) << h.stall_cycles << setw(9)
+            << __builtin_popcountll(h.writers) << "\n";
+    };
+    const char* counts =
+        " Invalidations  Upgrades  M-to-M  WB Stalls  Stall Cycles  Writers\n";
+    out << "\nCoherence Hotspots (" << hot.size() << " blocks with coherence events):\n";
+    out << "Top Blocks:\n" << left << setw(12) << "Block" << setw(6) << "Set" << right << counts;
+    for (const BlockHeat& h : hot.top_blocks(cfg.hotspots)) {
+        stringstream addr;
+        addr << "0x" << hex << setw(8) << setfill('0') << (h.block << cfg.b);
+        out << left << setw(12) << addr.str() << setw(6) << (h.block & ((1u << cfg.s) - 1)) << right;
+        row(h);
+    }
+    out << "Top Sets:\n" << left << setw(18) << "Set" << right << counts;
+    for (const BlockHeat& h : hot.top_sets(cfg.hotspots, cfg.s)) {
+        out << left << setw(18) << h.block << right;
+        row(h);
+    }
+    out << "Likely False Sharing:\n";
+    vector<BlockHeat> shared = hot.top_false_sharing(cfg.hotspots);
+    if (shared.empty()) out << "none\n";
+    for (const BlockHeat& h : shared) {
+        out << format_addr(h.block << cfg.b, cfg.s, cfg.b) << ":";
+        const char* sep = " ";
+        for (int w = 0; w < BlockHeat::WORDS; w++)
+            if (h.written >> w & 1) {
+                out << sep << "offset " << 4 * w << " core " << h.last[w] - 1;
+                sep = ", ";
+            }
+        out << " (" << h.events() << " events)\n";
+    }
+}
+
+// Writes the text report printed by L1simulate.
+inline void write_report(ostream& out, const string& pref, const SimConfig& cfg,
+                         const SimResult& res) {
+    out << "Simulation Parameters:\n";
+    out << "Trace Prefix: " << pref << "\n";
+    out << "Set Index Bits: " << cfg.s << "\n";
+    out << "Associativity: " << cfg.E << "\n";
+    out << "Block Bits: " << cfg.b << "\n";
+    out << "Block Size (Bytes): " << (1 << cfg.b) << "\n";
+    out << "Number of Sets: " << (1 << cfg.s) << "\n";
+    out << "Cache Size (KB per core): " << ((1 << cfg.s) * cfg.E * (1 << cfg.b) / 1024)
+         << "\n";
+    out << "Simulator Memory per Cache (Bytes): " << res.cache_bytes << "\n";
+    out << "MESI Protocol: Enabled\n";
+    out << "Write Policy: Write-back, Write-allocate\n";
+    out << "Replacement Policy: " << replacement_name(cfg.replacement) << "\n";
+    if (cfg.buses > 1)
+        out << "Bus: " << cfg.buses << " address-interleaved snooping buses";
+    else
+        out << "Bus: Central snooping bus";
+    if (cfg.arbitration != ARB_FIXED) out << ", " << arbitration_name(cfg.arbitration) << " arbitration";
+    out << "\n\n";
+
+    unsigned long long total_bus_tx = 0, total_bus_traffic = 0;
+    for (int c = 0; c < cfg.cores; c++) {
+        double miss_rate =
+            res.st[c].misses / double(res.st[c].instr) * 100.0;
+        out << "Core " << c << " Statistics:\n";
+        out << "Total Instructions: " << res.st[c].instr << "\n";
+        out << "Total Reads: " << res.st[c].reads << "\n";
+        out << "Total Writes: " << res.st[c].writes << "\n";
+        out << "Total Execution Cycles: " << res.st[c].execution_cycles << "\n";
+        out << "Idle Cycles: " << res.st[c].idle << "\n";
+        out << "Cache Misses: " << res.st[c].misses << "\n";
+        out << fixed << setprecision(2) << "Cache Miss Rate: " << miss_rate
+             << "%\n";
+        out << "Cache Evictions: " << res.st[c].evictions << "\n";
+        out << "Writebacks: " << res.st[c].writebacks << "\n";
+        out << "Bus Invalidations: " << res.st[c].invalidations << "\n";
+        out << "Data Traffic (Bytes): " << res.st[c].traffic << "\n\n";
+        total_bus_tx += res.st[c].bus_transactions;
+        total_bus_traffic += res.st[c].traffic;
+    }
+
+    out << "Overall Bus Summary:\n";
+    out << "Total Bus Transactions: " << total_bus_tx << "\n";
+    out << "Total Bus Traffic (Bytes): " << total_bus_traffic << "\n";
+    // With several buses, utilisation is the average over them.
+    int buses = max(cfg.buses, 1);
+    if (cfg.interval) {
+        out << "Bus Utilization (average): " << fixed << setprecision(2)
+            << (res.cycles > res.series_from
+                    ? res.bus_busy * 100.0 / (res.cycles - res.series_from) / buses
+                    : 0.0)
+            << "%\n";
+        out << "Bus Utilization (peak " << cfg.interval << "-cycle interval): "
+            << res.peak_busy * 100.0 / cfg.interval / buses << "% from cycle " << res.peak_start
+            << "\n";
+    }
+    if (buses > 1)
+        for (size_t k = 0; k < res.buses.size(); k++)
+            out << "Bus " << k << ": " << res.buses[k].transactions << " transactions, "
+                << res.buses[k].busy << " busy cycles, " << fixed << setprecision(2)
+                << (res.cycles ? res.buses[k].busy * 100.0 / res.cycles : 0.0)
+                << "% utilization\n";
+    out << "Simulation Run Time (seconds): " << fixed << setprecision(6) << res.seconds << "\n";
+    out << "Total Cycles: " << res.cycles << "\n";
+    if (!res.sampled.empty()) write_sampling_summary(out, cfg, res.sampled);
+    if (cfg.hotspots) write_hotspot_report(out, cfg, res.hotspots);
+}
+
+inline void write_histogram(ostream& out, const Histogram& h) {
+    out << "[";
+    for (size_t k = 0; k < h.buckets.size(); k++) out << (k ? ", " : "") << h.buckets[k];
+    out << "]";
+}
+
+// Writes the configuration, every Stats field and the instrumentation as
+// one JSON object (L1simulate -j). Histogram bucket k counts values in
+// [2^(k-1), 2^k), bucket 0 zeros.
+inline void write_json_report(ostream& out, const string& pref, const SimConfig& cfg,
+                              const SimResult& res) {
+    out << "{\n";
+    out << "  \"trace\": " << json_string(pref) << ",\n";
+    out << "  \"config\": {\"s\": " << cfg.s << ", \"E\": " << cfg.E << ", \"b\": " << cfg.b
+        << ", \"cores\": " << cfg.cores << ", \"replacement\": "
+        << json_string(replacement_name(cfg.replacement));
+    if (cfg.buses > 1 || cfg.arbitration != ARB_FIXED)
+        out << ", \"buses\": " << cfg.buses << ", \"arbitration\": "
+            << json_string(arbitration_name(cfg.arbitration));
+    out << "},\n";
+    out << "  \"cycles\": " << res.cycles << ",\n";
+    out << "  \"seconds\": " << fixed << setprecision(6) << res.seconds << ",\n";
+    out << "  \"cache_bytes\": " << res.cache_bytes << ",\n";
+    if (cfg.interval)
+        out << "  \"bus_utilization\": {\"interval\": " << cfg.interval
+            << ", \"busy_cycles\": " << res.bus_busy << ", \"peak_busy_cycles\": "
+            << res.peak_busy << ", \"peak_start\": " << res.peak_start << "},\n";
+    if (cfg.buses > 1) {
+        out << "  \"buses\": [";
+        for (size_t k = 0; k < res.buses.size(); k++)
+            out << (k ? ", " : "") << "{\"bus\": " << k << ", \"transactions\": "
+                << res.buses[k].transactions << ", \"busy_cycles\": " << res.buses[k].busy << "}";
+        out << "],\n";
+    }
+    out << "  \"cores\": [";
+    for (int c = 0; c < cfg.cores; c++) {
+        const Stats& st = res.st[c];
+        out << (c ? ",\n" : "\n") << "    {\"core\": " << c << ", \"instructions\": " << st.instr
+            << ", \"reads\": " << st.reads << ", \"writes\": " << st.writes
+            << ", \"execution_cycles\": " << st.execution_cycles << ", \"idle_cycles\": " << st.idle
+            << ", \"misses\": " << st.misses << ", \"evictions\": " << st.evictions
+            << ", \"writebacks\": " << st.writebacks << ", \"invalidations\": " << st.invalidations
+            << ", \"traffic_bytes\": " << st.traffic << ", \"bus_transactions\": "
+            << st.bus_transactions;
+#if L1SIM_PROFILE
+        out << ",\n     \"miss_latency\": ";
+        write_histogram(out, res.profile.miss_latency[c]);
+        out << ", \"bus_wait\": ";
+        write_histogram(out, res.profile.bus_wait[c]);
+#endif
+        out << "}";
+    }
+    out << "\n  ],\n";
+#if L1SIM_PROFILE
+    // The snoop phase runs inside the issue phase, so its time is also
+    // part of the issue time.
+    const Profile& p = res.profile;
+    out << "  \"profile\": {\"timed\": " << (p.timing ? "true" : "false") << ", \"phases\": {";
+    for (int ph = 0; ph < PHASE_COUNT; ph++) {
+        out << (ph ? ", " : "") << "\"" << phase_name(ph) << "\": {\"calls\": " << p.calls[ph];
+        if (p.timing) out << ", \"seconds\": " << setprecision(9) << p.ticks[ph] * p.seconds_per_tick;
+        out << "}";
+    }
+    out << "}}\n";
+#else
+    out << "  \"profile\": null\n";
+#endif
+    out << "}\n";
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include "simulator.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "kernels.hpp"
+
+using namespace std;
+
+SimResult simulate(const SimConfig& cfg, vector<TraceFile>& refq) {
+    switch (cfg.replacement) {
+    case REPL_PLRU:
+        return simulate_with<PLRUPolicy>(cfg, refq);
+    case REPL_SRRIP:
+        return simulate_with<SRRIPPolicy>(cfg, refq);
+    case REPL_BRRIP:
+        return simulate_with<BRRIPPolicy>(cfg, refq);
+    default:
+        if (!cfg.generic)
+            if (SimKernel k = specialised_kernel(cfg.s, cfg.E, cfg.b)) return k(cfg, refq);
+        return simulate_with<LRUPolicy>(cfg, refq);
+    }
+}
+
+// The loop runs on `worker` once run_until() has been called. It and the
+// caller take turns: the caller sets `stop` and clears `paused`, then waits
+// until the loop pauses again or finishes; the loop's pause() publishes its
+// cycle and Stats and waits to be let go. Only one of them runs at a time.
+struct Simulator::Impl : SimControl {
+    SimConfig cfg;
+    vector<TraceFile> refq;
+    SimResult res;
+    vector<Stats> st;
+    unsigned long long now = 0;
+    bool opened = false, finished = false, paused = false, quit = false;
+    thread worker;
+    mutex mu;
+    condition_variable cv;
+
+    bool pause(unsigned long long cycle, const vector<Stats>& s) override {
+        unique_lock<mutex> lk(mu);
+        now = cycle;
+        st = s;
+        paused = true;
+        cv.notify_all();
+        cv.wait(lk, [&] { return !paused; });
+        return !quit;
+    }
+
+    void finish(SimResult r) {
+        lock_guard<mutex> lk(mu);
+        res = std::move(r);
+        cfg.control = nullptr;
+        now = res.cycles;
+        st = res.st;
+        finished = true;
+        cv.notify_all();
+    }
+
+    // Lets the loop run to `until` and waits for it to get there or end.
+    void resume(unsigned long long until) {
+        unique_lock<mutex> lk(mu);
+        stop = until;
+        if (!worker.joinable()) {
+            cfg.control = this;
+            worker = thread([this] { finish(simulate(cfg, refq)); });
+        } else {
+            paused = false;
+            cv.notify_all();
+        }
+        cv.wait(lk, [&] { return paused || finished; });
+    }
+
+    ~Impl() {
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> lk(mu);
+            quit = true;
+            paused = false;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+};
+
+Simulator::Simulator() : impl(new Impl) {}
+
+Simulator::~Simulator() {}
+
+bool Simulator::open(const SimulatorConfig& cfg, string& err) {
+    if (impl->opened) {
+        err = "Simulator is already open";
+        return false;
+    }
+    if (cfg.traces.empty()) {
+        err = "No traces to simulate";
+        return false;
+    }
+    if (cfg.sim.cores > 0 && size_t(cfg.sim.cores) != cfg.traces.size()) {
+        err = "Configured for " + to_string(cfg.sim.cores) + " cores but given " +
+              to_string(cfg.traces.size()) + " traces";
+        return false;
+    }
+    SimConfig sim = cfg.sim;
+    sim.cores = int(cfg.traces.size());
+    if (!check_config(sim, err)) return false;
+    vector<TraceFile> refq(cfg.traces.size());
+    for (size_t c = 0; c < cfg.traces.size(); c++) {
+        const TraceSource& t = cfg.traces[c];
+        if (t.path.empty())
+            refq[c] = TraceFile(t.refs, t.count);
+        else if (!refq[c].open(t.path, err, t.window))
+            return false;
+    }
+    impl->cfg = sim;
+    impl->refq = std::move(refq);
+    impl->st.assign(impl->cfg.cores, Stats());
+    impl->opened = true;
+    return true;
+}
+
+// Marks a Simulator that was never opened.
+static bool not_open(SimResult& res) {
+    res.error = "Simulator is not open";
+    return false;
+}
+
+bool Simulator::run() {
+    if (!impl->opened) return not_open(impl->res);
+    if (impl->finished) return error().empty();
+    if (impl->worker.joinable()) {
+        impl->resume(UINT64_MAX);
+        impl->worker.join();
+    } else {
+        impl->finish(simulate(impl->cfg, impl->refq));
+    }
+    return error().empty();
+}
+
+bool Simulator::run_until(unsigned long long cycle) {
+    if (!impl->opened) return not_open(impl->res);
+    if (impl->finished) return error().empty();
+    if (impl->worker.joinable() && cycle <= impl->now) return true;
+    impl->resume(cycle);
+    if (impl->finished) impl->worker.join();
+    return error().empty();
+}
+
+bool Simulator::step() { return run_until(impl->now + 1); }
+
+bool Simulator::done() const { return impl->finished; }
+
+unsigned long long Simulator::cycle() const { return impl->now; }
+
+const vector<Stats>& Simulator::stats() const { return impl->st; }
+
+const SimResult& Simulator::result() const { return impl->res; }
+
+const SimConfig& Simulator::config() const { return impl->cfg; }
+
+const string& Simulator::error() const { return impl->res.error; }
@@ -0,0 +1,84 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "simulate.hpp"
+
+using namespace std;
+
+// One core's references: a trace file (streamed if `window` is non-zero,
+// as with -w), or references in memory that the caller keeps alive while
+// the Simulator reads them.
+struct TraceSource {
+    string path;
+    size_t window = 0;
+    const Ref* refs = nullptr;
+    size_t count = 0;
+
+    static TraceSource file(const string& path, size_t window = 0) {
+        TraceSource t;
+        t.path = path;
+        t.window = window;
+        return t;
+    }
+    static TraceSource memory(const Ref* refs, size_t count) {
+        TraceSource t;
+        t.refs = refs;
+        t.count = count;
+        return t;
+    }
+    static TraceSource memory(const vector<Ref>& refs) { return memory(refs.data(), refs.size()); }
+};
+
+struct SimulatorConfig {
+    SimConfig sim;               // geometry and options; sim.cores follows traces
+    vector<TraceSource> traces;  // one per core
+};
+
+// The MESI simulation as a library (libl1sim.a). open() loads the traces;
+// the run can then go to the end at once with run(), or be advanced with
+// run_until() and step() and looked at in between. Between calls the run
+// sits at the top of cycle(), before that cycle runs, exactly where the
+// loop would pass through it in a single run, so the results are the same
+// however it is driven. Errors come back as false with a message in
+// error(), as everywhere else in the simulator.
+//
+// A run that is only ever run() stays on the calling thread; run_until()
+// and step() move it to a thread of its own that waits between calls.
+class Simulator {
+public:
+    Simulator();
+    ~Simulator();
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    bool open(const SimulatorConfig& cfg, string& err);
+
+    // Runs to the end.
+    bool run();
+    // Runs until the top of `cycle`, or the end if that comes first.
+    bool run_until(unsigned long long cycle);
+    // Runs one cycle.
+    bool step();
+
+    bool done() const;
+    unsigned long long cycle() const;
+    const vector<Stats>& stats() const;
+    const Stats& stats(int core) const { return stats()[core]; }
+    // The whole result, once done().
+    const SimResult& result() const;
+    const SimConfig& config() const;
+    const string& error() const;
+
+private:
+    struct Impl;
+    unique_ptr<Impl> impl;
+};
+
+// Runs the MESI simulation with the replacement policy chosen in cfg, on a
+// specialised kernel when one exists for the geometry (kernels.hpp).
+SimResult simulate(const SimConfig& cfg, vector<TraceFile>& refq);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SNOOP_HPP
+#define SNOOP_HPP
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Sharer directory for the snooping bus: maps a block address (tag and set,
+// i.e. addr >> b) to a bitmask of the cores holding it in a valid, non-I line
+// and the way it sits in for each of them. A snoop then only has to look at
+// the cores in the mask. Open addressing with linear probing; the table grows
+// with the number of resident blocks and is never shrunk.
+struct SnoopFilter {
+    SnoopFilter(int cores) : cores(cores), used(0) { rehash(1024); }
+
+    uint64_t sharers(unsigned int block) const {
+        size_t i = find(block);
+        return i == NONE ? 0 : masks[i];
+    }
+
+    int way(unsigned int block, int core) const {
+        size_t i = find(block);
+        if (i == NONE || !(masks[i] >> core & 1)) return -1;
+        return ways[i * cores + core];
+    }
+
+    void add(unsigned int block, int core, int way) {
+        if ((used + 1) * 2 > keys.size()) rehash(keys.size() * 2);
+        size_t i = home(block);
+        while (masks[i] && keys[i] != block) i = (i + 1) & slot_mask;
+        if (!masks[i]) {
+            keys[i] = block;
+            used++;
+        }
+        masks[i] |= uint64_t(1) << core;
+        ways[i * cores + core] = uint16_t(way);
+    }
+
+    void remove(unsigned int block, int core) {
+        size_t i = find(block);
+        if (i == NONE) return;
+        masks[i] &= ~(uint64_t(1) << core);
+        if (masks[i]) return;
+        used--;
+        // Backward-shift deletion keeps every probe chain unbroken.
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & slot_mask;
+            if (!masks[j]) break;
+            size_t h = home(keys[j]);
+            if ((j > i && (h <= i || h > j)) || (j < i && h <= i && h > j)) {
+                keys[i] = keys[j];
+                masks[i] = masks[j];
+                for (int c = 0; c < cores; c++)
+                    ways[i * cores + c] = ways[j * cores + c];
+                masks[j] = 0;
+                i = j;
+            }
+        }
+    }
+
+private:
+    static const size_t NONE = SIZE_MAX;
+    int cores;
+    size_t used;
+    size_t slot_mask;
+    vector<unsigned int> keys;
+    vector<uint64_t> masks;  // 0 marks an empty slot
+    vector<uint16_t> ways;   // cores entries per slot
+
+    size_t home(unsigned int block) const {
+        return size_t((block * 0x9E3779B97F4A7C15ull) >> 32) & slot_mask;
+    }
+
+    size_t find(unsigned int block) const {
+        size_t i = home(block);
+        while (masks[i]) {
+            if (keys[i] == block) return i;
+            i = (i + 1) & slot_mask;
+        }
+        return NONE;
+    }
+
+    void rehash(size_t slots) {
+        vector<unsigned int> old_keys;
+        vector<uint64_t> old_masks;
+        vector<uint16_t> old_ways;
+        old_keys.swap(keys);
+        old_masks.swap(masks);
+        old_ways.swap(ways);
+        keys.assign(slots, 0);
+        masks.assign(slots, 0);
+        ways.assign(slots * cores, 0);
+        slot_mask = slots - 1;
+        for (size_t j = 0; j < old_keys.size(); j++) {
+            if (!old_masks[j]) continue;
+            size_t i = home(old_keys[j]);
+            while (masks[i]) i = (i + 1) & slot_mask;
+            keys[i] = old_keys[j];
+            masks[i] = old_masks[j];
+            for (int c = 0; c < cores; c++)
+                ways[i * cores + c] = old_ways[j * cores + c];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef STACKDIST_HPP
+#define STACKDIST_HPP
+
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "pool.hpp"
+#include "sweep.hpp"
+#include "trace.hpp"
+
+using namespace std;
+
+// Last-access times of the blocks in one set, with rank queries.
+typedef __gnu_pbds::tree<unsigned long long, __gnu_pbds::null_type, less<unsigned long long>,
+                         __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update>
+    OrderTree;
+
+// LRU stack distance histograms of one core's trace for one block size, one
+// per set count. hist[k][d] counts references whose block had d other blocks
+// of its set touched since its previous use, with 2^s_vals[k] sets; the last
+// bucket (d = max_assoc) also holds first uses. With A ways the references
+// with d >= A miss.
+struct StackProfile {
+    int core = 0, b = 0;
+    unsigned long long refs = 0;
+    vector<int> s_vals;
+    vector<vector<unsigned long long>> hist;
+
+    unsigned long long misses(size_t k, int assoc) const {
+        unsigned long long n = 0;
+        for (size_t d = assoc; d < hist[k].size(); d++) n += hist[k][d];
+        return n;
+    }
+};
+
+// Measures every set count in s_vals in a single pass over the trace. Each
+// set keeps the access times of its max_assoc most recent blocks in an order
+// statistics tree, so a block's distance is the number of later times in
+// its set; a block that dropped out of the tree is at least max_assoc deep.
+inline StackProfile stack_profile(const Ref* refs, size_t n, int core, int b,
+                                  const vector<int>& s_vals, int max_assoc) {
+    StackProfile p;
+    p.core = core;
+    p.b = b;
+    p.refs = n;
+    p.s_vals = s_vals;
+    p.hist.assign(s_vals.size(), vector<unsigned long long>(max_assoc + 1, 0));
+
+    vector<vector<OrderTree>> sets(s_vals.size());
+    for (size_t k = 0; k < s_vals.size(); k++) sets[k].resize(size_t(1) << s_vals[k]);
+    unordered_map<unsigned int, unsigned long long> last_use;
+
+    for (size_t now = 0; now < n; now++) {
+        unsigned int block = refs[now].addr >> b;
+        auto it = last_use.find(block);
+        bool seen = it != last_use.end();
+        unsigned long long prev = seen ? it->second : 0;
+        for (size_t k = 0; k < s_vals.size(); k++) {
+            OrderTree& t = sets[k][block & ((1u << s_vals[k]) - 1)];
+            size_t d = max_assoc;
+            // The tree holds the newest times of the set, so the block is in it
+            // exactly when its last use is not older than the oldest entry.
+            if (seen && !t.empty() && prev >= *t.begin()) {
+                d = t.size() - 1 - t.order_of_key(prev);
+                t.erase(prev);
+            } else if (int(t.size()) == max_assoc) {
+                t.erase(t.begin());
+            }
+            t.insert(now);
+            p.hist[k][d]++;
+        }
+        if (seen)
+            it->second = now;
+        else
+            last_use.emplace(block, now);
+    }
+    return p;
+}
+
+// Profiles every (core, block size) pair of `traces` on `threads` workers.
+// Results come back core-major, then in b_vals order.
+inline vector<StackProfile> run_stack_profiles(const vector<TraceFile>& traces,
+                                               const vector<int>& s_vals,
+                                               const vector<int>& b_vals, int max_assoc,
+                                               unsigned threads) {
+    vector<StackProfile> out(traces.size() * b_vals.size());
+    ThreadPool pool(threads);
+    for (size_t c = 0; c < traces.size(); c++)
+        for (size_t j = 0; j < b_vals.size(); j++)
+            pool.submit([&, c, j] {
+                out[c * b_vals.size() + j] = stack_profile(
+                    traces[c].begin(), traces[c].size(), int(c), b_vals[j], s_vals, max_assoc);
+            });
+    pool.wait();
+    return out;
+}
+
+// One row per core, block size, set count and associativity, as CSV or as
+// a JSON array of objects. Coherence is ignored: every core runs alone.
+inline void write_stack_table(ostream& out, bool json, const string& pref,
+                              const vector<StackProfile>& profiles,
+                              const vector<int>& e_vals) {
+    static const char* cols[] = {"trace", "core", "b", "s", "E", "refs", "misses", "miss_rate"};
+    const size_t ncols = sizeof(cols) / sizeof(cols[0]);
+
+    if (json)
+        out << "[\n";
+    else
+        for (size_t k = 0; k < ncols; k++) out << cols[k] << (k + 1 < ncols ? "," : "\n");
+
+    bool first = true;
+    for (const StackProfile& p : profiles) {
+        for (size_t k = 0; k < p.s_vals.size(); k++) {
+            for (int E : e_vals) {
+                unsigned long long misses = p.misses(k, E);
+                stringstream rate;
+                if (p.refs > 0)
+                    rate << fixed << setprecision(4) << misses / double(p.refs) * 100.0;
+                else
+                    rate << (json ? "null" : "");
+                string vals[] = {json ? json_string(pref) : pref, to_string(p.core),
+                                 to_string(p.b), to_string(p.s_vals[k]), to_string(E),
+                                 to_string(p.refs), to_string(misses), rate.str()};
+                if (json) {
+                    out << (first ? "  {" : ",\n  {");
+                    for (size_t i = 0; i < ncols; i++)
+                        out << "\"" << cols[i] << "\": " << vals[i] << (i + 1 < ncols ? ", " : "}");
+                } else {
+                    for (size_t i = 0; i < ncols; i++) out << vals[i] << (i + 1 < ncols ? "," : "\n");
+                }
+                first = false;
+            }
+        }
+    }
+    if (json) out << "\n]\n";
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "pool.hpp"
+#include "simulator.hpp"
+
+using namespace std;
+
+// Parses a parameter list such as "5", "4,6,8" or "4-8" (inclusive).
+// Returns false if the text is not of that form.
+inline bool parse_values(const string& text, vector<int>& out) {
+    out.clear();
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ',')) {
+        size_t dash = item.find('-', 1);
+        try {
+            if (dash == string::npos) {
+                out.push_back(stoi(item));
+            } else {
+                int lo = stoi(item.substr(0, dash)), hi = stoi(item.substr(dash + 1));
+                if (lo > hi) return false;
+                for (int v = lo; v <= hi; v++) out.push_back(v);
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+// Simulates every (s, E, b) combination of the given lists on `threads`
+// workers. All runs read the same already-loaded traces through views, so
+// each trace is parsed once. Results come back in s-major, then E, then b
+// order.
+inline vector<SimResult> run_sweep(const SimConfig& base, const vector<int>& ss,
+                                   const vector<int>& es, const vector<int>& bs,
+                                   const vector<TraceFile>& traces, unsigned threads,
+                                   vector<SimConfig>& configs) {
+    configs.clear();
+    for (int s : ss)
+        for (int E : es)
+            for (int b : bs) {
+                SimConfig cfg = base;
+                cfg.s = s;
+                cfg.E = E;
+                cfg.b = b;
+                configs.push_back(cfg);
+            }
+    vector<SimResult> results(configs.size());
+    ThreadPool pool(threads);
+    for (size_t i = 0; i < configs.size(); i++) {
+        pool.submit([&, i] {
+            vector<TraceFile> refq;
+            for (const TraceFile& t : traces) refq.emplace_back(t.begin(), t.size());
+            results[i] = simulate(configs[i], refq);
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+// One row per configuration and core, as CSV or as a JSON array of objects.
+inline void write_sweep_table(ostream& out, bool json, const string& pref,
+                              const vector<SimConfig>& configs,
+                              const vector<SimResult>& results) {
+    static const char* cols[] = {
+        "trace", "s", "E", "b", "core", "instructions", "reads", "writes",
+        "execution_cycles", "idle_cycles", "misses", "miss_rate", "evictions",
+        "writebacks", "invalidations", "traffic_bytes", "bus_transactions",
+        "total_cycles", "run_seconds"};
+    const size_t ncols = sizeof(cols) / sizeof(cols[0]);
+
+    if (json)
+        out << "[\n";
+    else
+        for (size_t k = 0; k < ncols; k++) out << cols[k] << (k + 1 < ncols ? "," : "\n");
+
+    bool first = true;
+    for (size_t i = 0; i < configs.size(); i++) {
+        const SimConfig& cfg = configs[i];
+        const SimResult& res = results[i];
+        for (int c = 0; c < cfg.cores; c++) {
+            const Stats& st = res.st[c];
+            stringstream rate;
+            if (st.instr > 0)
+                rate << fixed << setprecision(4) << st.misses / double(st.instr) * 100.0;
+            else
+                rate << (json ? "null" : "");
+            stringstream secs;
+            secs << fixed << setprecision(6) << res.seconds;
+            string vals[] = {
+                json ? json_string(pref) : pref, to_string(cfg.s), to_string(cfg.E),
+                to_string(cfg.b), to_string(c), to_string(st.instr),
+                to_string(st.reads), to_string(st.writes),
+                to_string(st.execution_cycles), to_string(st.idle),
+                to_string(st.misses), rate.str(), to_string(st.evictions),
+                to_string(st.writebacks), to_string(st.invalidations),
+                to_string(st.traffic), to_string(st.bus_transactions),
+                to_string(res.cycles), secs.str()};
+            if (json) {
+                out << (first ? "  {" : ",\n  {");
+                for (size_t k = 0; k < ncols; k++)
+                    out << "\"" << cols[k] << "\": " << vals[k] << (k + 1 < ncols ? ", " : "}");
+            } else {
+                for (size_t k = 0; k < ncols; k++) out << vals[k] << (k + 1 < ncols ? "," : "\n");
+            }
+            first = false;
+        }
+    }
+    if (json) out << "\n]\n";
+}
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Ref {
+    char type;
+    unsigned int addr;
+};
+
+// Binary traces are one file per core, like the text ones: a TraceHeader
+// followed by `records` Ref records stored exactly as they sit in memory
+// (type byte, three zero bytes, little-endian address), so a mapped file can
+// be read in place.
+static_assert(sizeof(Ref) == 8, "binary trace records are 8 bytes");
+
+const char TRACE_MAGIC[8] = {'L', '1', 'T', 'R', 'A', 'C', 'E', '\0'};
+const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cores;  // number of cores in the trace set
+    uint32_t core;   // which core this file belongs to
+    uint32_t reserved;
+    uint64_t records;
+};
+static_assert(sizeof(TraceHeader) == 32, "trace header is 32 bytes");
+
+// Reads a trace on a background thread into two fixed-size chunks. The
+// consumer walks one chunk while the other is refilled, so only two chunks
+// of references are ever held in memory.
+class TracePrefetcher {
+public:
+    // `f` is positioned at the first record (binary) or line (text).
+    TracePrefetcher(ifstream&& f, bool binary, uint64_t records, size_t chunk)
+        : in(std::move(f)), binary(binary), remaining(records), chunk(chunk),
+          stop(false), current(-1), filled{false, false},
+          worker(&TracePrefetcher::produce, this) {}
+    TracePrefetcher(const TracePrefetcher&) = delete;
+    TracePrefetcher& operator=(const TracePrefetcher&) = delete;
+    ~TracePrefetcher() {
+        {
+            lock_guard<mutex> lk(mu);
+            stop = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    // Hands the chunk in use back to the producer and waits for the next one.
+    // Returns false once the trace is exhausted.
+    bool next(const Ref*& cur, const Ref*& end) {
+        unique_lock<mutex> lk(mu);
+        int k = current < 0 ? 0 : current ^ 1;
+        if (current >= 0) {
+            filled[current] = false;
+            cv.notify_all();
+        }
+        cv.wait(lk, [&] { return filled[k]; });
+        current = k;
+        cur = buf[k].data();
+        end = cur + buf[k].size();
+        return !buf[k].empty();
+    }
+
+private:
+    ifstream in;
+    bool binary;
+    uint64_t remaining;
+    size_t chunk;
+    bool stop;
+    int current;
+    vector<Ref> buf[2];
+    bool filled[2];
+    mutex mu;
+    condition_variable cv;
+    thread worker;
+
+    void produce() {
+        for (int k = 0;; k ^= 1) {
+            {
+                unique_lock<mutex> lk(mu);
+                cv.wait(lk, [&] { return stop || !filled[k]; });
+                if (stop) return;
+            }
+            fill(buf[k]);
+            bool eof = buf[k].empty();
+            {
+                lock_guard<mutex> lk(mu);
+                filled[k] = true;
+            }
+            cv.notify_all();
+            if (eof) return;
+        }
+    }
+
+    void fill(vector<Ref>& out) {
+        out.clear();
+        if (binary) {
+            size_t n = size_t(min<uint64_t>(chunk, remaining));
+            out.resize(n);
+            in.read(reinterpret_cast<char*>(out.data()), n * sizeof(Ref));
+            out.resize(in.gcount() / sizeof(Ref));
+            remaining -= out.size();
+            return;
+        }
+        char t;
+        string addr;
+        while (out.size() < chunk && in >> t >> addr) {
+            unsigned int a = stoul(addr, nullptr, 0);
+            out.push_back({t, a});
+        }
+    }
+};
+
+// The references of one core, either parsed from a text trace, mapped
+// straight from a binary one, or streamed through a TracePrefetcher.
+class TraceFile {
+public:
+    TraceFile() : cur(nullptr), end(nullptr), map(nullptr), map_len(0) {}
+    // A view of `n` references owned elsewhere, e.g. a trace that several
+    // simulations read at once.
+    TraceFile(const Ref* refs, size_t n)
+        : cur(refs), end(refs + n), map(nullptr), map_len(0) {}
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+    TraceFile(TraceFile&& o) noexcept { take(o); }
+    TraceFile& operator=(TraceFile&& o) noexcept {
+        if (this != &o) {
+            release();
+            take(o);
+        }
+        return *this;
+    }
+    ~TraceFile() { release(); }
+
+    // Loads `path`, detecting the format from its first bytes. A non-zero
+    // `window` streams the trace instead, keeping at most that many
+    // references in memory. On failure returns false and leaves a message
+    // in `err`.
+    bool open(const string& path, string& err, size_t window = 0) {
+        release();
+        ifstream f(path, ios::binary);
+        if (!f) {
+            err = "Cannot open " + path;
+            return false;
+        }
+        char magic[sizeof(TRACE_MAGIC)] = {};
+        f.read(magic, sizeof(magic));
+        bool binary = f.gcount() == sizeof(magic) &&
+                      memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+        if (window > 0) return open_stream(path, std::move(f), binary, window, err);
+        f.close();
+        return binary ? open_binary(path, err) : open_text(path, err);
+    }
+
+    bool empty() { return cur == end && !refill(); }
+    const Ref& front() const { return *cur; }
+    void pop_front() { ++cur; }
+    // Drops the next `n` references; returns how many there were.
+    size_t skip(size_t n) {
+        size_t done = 0;
+        while (done < n && !empty()) {
+            size_t k = min(n - done, size());
+            cur += k;
+            done += k;
+        }
+        return done;
+    }
+    // size() and begin() cover the whole trace only when it is not streamed.
+    size_t size() const { return end - cur; }
+    const Ref* begin() const { return cur; }
+    // True while more references may arrive beyond begin() + size().
+    bool streamed() const { return prefetch != nullptr; }
+
+private:
+    vector<Ref> owned;
+    const Ref* cur;
+    const Ref* end;
+    void* map;
+    size_t map_len;
+    unique_ptr<TracePrefetcher> prefetch;
+
+    bool refill() {
+        if (!prefetch) return false;
+        if (prefetch->next(cur, end)) return true;
+        prefetch.reset();
+        cur = end = nullptr;
+        return false;
+    }
+
+    bool open_stream(const string& path, ifstream&& f, bool binary,
+                     size_t window, string& err) {
+        uint64_t records = 0;
+        f.clear();
+        f.seekg(0);
+        if (binary) {
+            TraceHeader h;
+            f.read(reinterpret_cast<char*>(&h), sizeof(h));
+            if (f.gcount() != sizeof(h)) {
+                err = "Truncated binary trace " + path;
+                return false;
+            }
+            if (h.version != TRACE_VERSION) {
+                err = "Unsupported binary trace version in " + path;
+                return false;
+            }
+            records = h.records;
+        }
+        prefetch.reset(new TracePrefetcher(std::move(f), binary, records,
+                                           max<size_t>(window / 2, 1)));
+        return true;
+    }
+
+    bool open_text(const string& path, string& err) {
+        ifstream f(path);
+        if (!f) {
+            err = "Cannot open " + path;
+            return false;
+        }
+        char t;
+        string addr;
+        while (f >> t >> addr) {
+            unsigned int a = stoul(addr, nullptr, 0);
+            owned.push_back({t, a});
+        }
+        cur = owned.data();
+        end = cur + owned.size();
+        return true;
+    }
+
+    bool open_binary(const string& path, string& err) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            err = "Cannot open " + path;
+            return false;
+        }
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || size_t(sb.st_size) < sizeof(TraceHeader)) {
+            close(fd);
+            err = "Truncated binary trace " + path;
+            return false;
+        }
+        map_len = sb.st_size;
+        map = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            map = nullptr;
+            err = "Cannot map " + path;
+            return false;
+        }
+        const TraceHeader* h = static_cast<const TraceHeader*>(map);
+        if (h->version != TRACE_VERSION) {
+            release();
+            err = "Unsupported binary trace version in " + path;
+            return false;
+        }
+        if ((map_len - sizeof(TraceHeader)) / sizeof(Ref) < h->records) {
+            release();
+            err = "Truncated binary trace " + path;
+            return false;
+        }
+        madvise(map, map_len, MADV_SEQUENTIAL);
+        cur = reinterpret_cast<const Ref*>(static_cast<const char*>(map) +
+                                           sizeof(TraceHeader));
+        end = cur + h->records;
+        return true;
+    }
+
+    void take(TraceFile& o) {
+        owned = std::move(o.owned);
+        cur = o.cur;
+        end = o.end;
+        map = o.map;
+        map_len = o.map_len;
+        prefetch = std::move(o.prefetch);
+        o.cur = o.end = nullptr;
+        o.map = nullptr;
+        o.map_len = 0;
+    }
+
+    void release() {
+        if (map) munmap(map, map_len);
+        map = nullptr;
+        map_len = 0;
+        owned.clear();
+        prefetch.reset();
+        cur = end = nullptr;
+    }
+};
+
+// Writes `refs` as the binary trace of core `core` out of `cores`.
+inline bool write_binary_trace(const string& path, const vector<Ref>& refs,
+                               uint32_t cores, uint32_t core) {
+    ofstream f(path, ios::binary | ios::trunc);
+    if (!f) return false;
+    TraceHeader h;
+    memcpy(h.magic, TRACE_MAGIC, sizeof(h.magic));
+    h.version = TRACE_VERSION;
+    h.cores = cores;
+    h.core = core;
+    h.reserved = 0;
+    h.records = refs.size();
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    // Value-initialised records have zeroed padding, so files are reproducible.
+    vector<Ref> recs(refs.size());
+    for (size_t i = 0; i < refs.size(); i++) {
+        recs[i].type = refs[i].type;
+        recs[i].addr = refs[i].addr;
+    }
+    f.write(reinterpret_cast<const char*>(recs.data()),
+            recs.size() * sizeof(Ref));
+    return bool(f);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+using namespace std;
+
+// Converts a set of <prefix>_procN.trace text traces into the binary format
+// read by L1simulate. Cores are numbered from 0 until a file is missing.
+int main(int argc, char* argv[]) {
+    string pref, outpref;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-t" && i + 1 < argc)
+            pref = argv[++i];
+        else if (a == "-o" && i + 1 < argc)
+            outpref = argv[++i];
+        else if (a == "-h") {
+            cout << "-t <tracefile>: prefix of the text traces to convert\n";
+            cout << "-o <outprefix>: prefix of the binary traces to write\n";
+            cout << "-h: prints this help\n";
+            return 0;
+        }
+    }
+    if (pref.empty() || outpref.empty()) {
+        cerr << "Usage: traceconv -t <tracefile> -o <outprefix>\n";
+        return 1;
+    }
+
+    vector<vector<Ref>> refs;
+    while (true) {
+        string fn = pref + "_proc" + to_string(refs.size()) + ".trace";
+        ifstream probe(fn);
+        if (!probe) break;
+        probe.close();
+        TraceFile tf;
+        string err;
+        if (!tf.open(fn, err)) {
+            cerr << err << "\n";
+            return 1;
+        }
+        refs.emplace_back(tf.begin(), tf.begin() + tf.size());
+    }
+    if (refs.empty()) {
+        cerr << "Cannot open " << pref << "_proc0.trace\n";
+        return 1;
+    }
+
+    for (size_t c = 0; c < refs.size(); c++) {
+        string fn = outpref + "_proc" + to_string(c) + ".trace";
+        if (!write_binary_trace(fn, refs[c], refs.size(), c)) {
+            cerr << "Cannot write " << fn << "\n";
+            return 1;
+        }
+        cout << fn << ": " << refs[c].size() << " references\n";
+    }
+    return 0;
+}
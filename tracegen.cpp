@@ -0,0 +1,61 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "tracegen.hpp"
+
+using namespace std;
+
+// Writes a synthetic <prefix>_procN.trace set with one of the patterns in
+// tracegen.hpp.
+int main(int argc, char* argv[]) {
+    string outpref;
+    Pattern pat = PAT_PRIVATE;
+    int cores = 4;
+    size_t refs = 100000;
+    unsigned seed = 1;
+    bool binary = false;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "-o" && i + 1 < argc)
+            outpref = argv[++i];
+        else if (a == "-k" && i + 1 < argc) {
+            if (!parse_pattern(argv[++i], pat)) {
+                cerr << "Unknown pattern: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (a == "-p" && i + 1 < argc)
+            cores = stoi(argv[++i]);
+        else if (a == "-n" && i + 1 < argc)
+            refs = stoul(argv[++i]);
+        else if (a == "--seed" && i + 1 < argc)
+            seed = stoul(argv[++i]);
+        else if (a == "--binary")
+            binary = true;
+        else if (a == "-h") {
+            cout << "-o <outprefix>: prefix of the traces to write\n";
+            cout << "-k <pattern>: private, true, false, prodcons or random (default: private)\n";
+            cout << "-p <cores>: number of cores (default: 4)\n";
+            cout << "-n <refs>: references per core (default: 100000)\n";
+            cout << "--seed <n>: random seed (default: 1)\n";
+            cout << "--binary: write binary traces instead of text\n";
+            cout << "-h: prints this help\n";
+            return 0;
+        }
+    }
+    if (outpref.empty() || cores <= 0) {
+        cerr << "Usage: tracegen -o <outprefix> [-k <pattern>] [-p <cores>] [-n <refs>]\n";
+        return 1;
+    }
+
+    vector<vector<Ref>> traces = generate_traces(pat, cores, refs, seed);
+    for (int c = 0; c < cores; c++) {
+        string fn = outpref + "_proc" + to_string(c) + ".trace";
+        bool ok = binary ? write_binary_trace(fn, traces[c], cores, c)
+                         : write_text_trace(fn, traces[c]);
+        if (!ok) {
+            cerr << "Cannot write " << fn << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef TRACEGEN_HPP
+#define TRACEGEN_HPP
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+
+using namespace std;
+
+// Access patterns the synthetic trace generator can produce.
+//   private:  each core streams through its own 256 KB region
+//   true:     all cores read and write random words of one 4 KB region
+//   false:    each core writes its own word of a few shared 64-byte blocks
+//   prodcons: even cores write a 64 KB buffer that the next core reads
+//   random:   uniform accesses over 16 MB
+enum Pattern { PAT_PRIVATE, PAT_TRUE, PAT_FALSE, PAT_PRODCONS, PAT_RANDOM };
+
+inline bool parse_pattern(const string& name, Pattern& p) {
+    static const char* names[] = {"private", "true", "false", "prodcons", "random"};
+    for (int i = 0; i < 5; i++)
+        if (name == names[i]) {
+            p = Pattern(i);
+            return true;
+        }
+    return false;
+}
+
+// `refs` references for each of `cores` cores. The same arguments always
+// give the same traces.
+inline vector<vector<Ref>> generate_traces(Pattern pat, int cores, size_t refs,
+                                           unsigned seed) {
+    vector<vector<Ref>> out(cores);
+    for (int c = 0; c < cores; c++) {
+        mt19937 rng(seed * 1000003u + c);
+        auto chance = [&](unsigned percent) { return rng() % 100 < percent; };
+        unsigned int base = unsigned(c + 1) << 24;
+        vector<Ref>& v = out[c];
+        v.reserve(refs);
+        for (size_t i = 0; i < refs; i++) {
+            Ref r;
+            r.type = 'R';
+            switch (pat) {
+            case PAT_PRIVATE:
+                r.addr = base + unsigned(i * 4 % (256 << 10));
+                if (chance(25)) r.type = 'W';
+                break;
+            case PAT_TRUE:
+                r.addr = 0x100000 + rng() % 1024 * 4;
+                if (chance(30)) r.type = 'W';
+                break;
+            case PAT_FALSE:
+                r.addr = 0x100000 + rng() % 16 * 64 + unsigned(c % 16) * 4;
+                if (chance(50)) r.type = 'W';
+                break;
+            case PAT_PRODCONS: {
+                // Core 2k produces for core 2k + 1; a lone last core produces
+                // for nobody.
+                unsigned int buf = 0x200000 + unsigned(c / 2) * (64 << 10);
+                r.addr = buf + unsigned(i * 4 % (64 << 10));
+                if (c % 2 == 0) r.type = 'W';
+                break;
+            }
+            case PAT_RANDOM:
+                r.addr = rng() % (16u << 20) & ~3u;
+                if (chance(30)) r.type = 'W';
+                break;
+            }
+            v.push_back(r);
+        }
+    }
+    return out;
+}
+
+// Writes `refs` in the text trace format ("R 0x00100000" per line).
+inline bool write_text_trace(const string& path, const vector<Ref>& refs) {
+    ofstream f(path, ios::trunc);
+    if (!f) return false;
+    char line[32];
+    for (const Ref& r : refs) {
+        snprintf(line, sizeof(line), "%c 0x%08x\n", r.type, r.addr);
+        f << line;
+    }
+    return bool(f);
+}
+
+#endif
@@ -30,6 +30,16 @@ struct StallRequest {
     unsigned long long until_cycle;
 };
 
+template <class IO>
+void serialize(IO& io, PendingAllocation& pa) {
+    io(pa.core);
+    io(pa.set);
+    io(pa.victim);
+    io(pa.tag);
+    io(pa.state);
+    io(pa.complete_cycle);
+}
+
 enum ChangeType { STATE_TRANSITION, INVALIDATION };
 
 struct PlannedChange {
@@ -44,4 +54,17 @@ struct PlannedChange {
     ChangeType type;
 };
 
+template <class IO>
+void serialize(IO& io, PlannedChange& pc) {
+    io(pc.core);
+    io(pc.set);
+    io(pc.idx);
+    io(pc.valid);
+    io(pc.state);
+    io(pc.tag);
+    io(pc.last_used);
+    io(pc.apply_cycle);
+    io(pc.type);
+}
+
 #endif
\ No newline at end of file